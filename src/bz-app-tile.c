@@ -44,6 +44,8 @@ bz_app_tile_dispose (GObject *object)
 {
   BzAppTile *self = BZ_APP_TILE (object);
 
+  if (self->group != NULL)
+    bz_entry_group_cancel_prefetch_ui_entry (self->group);
   g_clear_object (&self->group);
 
   G_OBJECT_CLASS (bz_app_tile_parent_class)->dispose (object);
@@ -106,6 +108,19 @@ is_zero (gpointer object,
   return value == 0;
 }
 
+static void
+on_motion_enter (GtkEventController *controller,
+                 double              x,
+                 double              y,
+                 BzAppTile          *self)
+{
+  /* The pointer is a stronger hint than scrolling, so this
+   * bumps the group back to the front of the prefetch queue
+   */
+  if (self->group != NULL)
+    bz_entry_group_prefetch_ui_entry (self->group);
+}
+
 static void
 bz_app_tile_class_init (BzAppTileClass *klass)
 {
@@ -134,7 +149,13 @@ bz_app_tile_class_init (BzAppTileClass *klass)
 static void
 bz_app_tile_init (BzAppTile *self)
 {
+  GtkEventController *motion = NULL;
+
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  motion = gtk_event_controller_motion_new ();
+  g_signal_connect (motion, "enter", G_CALLBACK (on_motion_enter), self);
+  gtk_widget_add_controller (GTK_WIDGET (self), motion);
 }
 
 GtkWidget *
@@ -156,9 +177,19 @@ bz_app_tile_set_group (BzAppTile    *self,
 {
   g_return_if_fail (BZ_IS_APP_TILE (self));
 
+  if (group == self->group)
+    return;
+
+  /* The tile was recycled or unbound, so the old group is out of view */
+  if (self->group != NULL)
+    bz_entry_group_cancel_prefetch_ui_entry (self->group);
   g_clear_object (&self->group);
+
   if (group != NULL)
-    self->group = g_object_ref (group);
+    {
+      self->group = g_object_ref (group);
+      bz_entry_group_prefetch_ui_entry (group);
+    }
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_GROUP]);
 }
@@ -796,6 +796,10 @@ init_service_struct (BzApplication *self)
   self->search_engine = bz_search_engine_new ();
   bz_search_engine_set_model (self->search_engine, G_LIST_MODEL (self->group_filter_model));
   bz_gnome_shell_search_provider_set_engine (self->gs_search, self->search_engine);
+  /* Let shell searches run against the previous
+   * session's catalog until the first refresh is done
+   */
+  dex_future_disown (bz_search_engine_load_index (self->search_engine));
 
   self->content_provider         = bz_content_provider_new ();
   self->content_configs_to_files = gtk_map_list_model_new (
@@ -1038,46 +1042,21 @@ fiber_check_for_updates (BzApplication *self)
   if (update_ids != NULL &&
       update_ids->len > 0)
     {
-      g_autoptr (GPtrArray) futures = NULL;
-      g_autoptr (GListStore) store  = NULL;
-
-      futures = g_ptr_array_new_with_free_func (dex_unref);
-      for (guint i = 0; i < update_ids->len; i++)
+      g_autoptr (GListModel) store = NULL;
+
+      /* Entries which cannot be resolved are
+       * left out of the update list
+       */
+      store = dex_await_object (
+          bz_entry_cache_manager_get_many (self->cache, update_ids),
+          &local_error);
+      if (store == NULL)
         {
-          const char *unique_id = NULL;
-
-          unique_id = g_ptr_array_index (update_ids, i);
-          g_ptr_array_add (futures, bz_entry_cache_manager_get (self->cache, unique_id));
+          g_warning ("Failed to resolve the update list: %s", local_error->message);
+          g_clear_pointer (&local_error, g_error_free);
         }
-
-      dex_await (
-          dex_future_allv ((DexFuture *const *) futures->pdata, futures->len),
-          NULL);
-
-      store = g_list_store_new (BZ_TYPE_ENTRY);
-      for (guint i = 0; i < futures->len; i++)
-        {
-          DexFuture    *future = NULL;
-          const GValue *value  = NULL;
-
-          future = g_ptr_array_index (futures, i);
-          value  = dex_future_get_value (future, &local_error);
-
-          if (value != NULL)
-            g_list_store_append (store, g_value_get_object (value));
-          else
-            {
-              const char *unique_id = NULL;
-
-              unique_id = g_ptr_array_index (update_ids, i);
-              g_warning ("%s could not be resolved for the update list and thus will not be included: %s",
-                         unique_id, local_error->message);
-              g_clear_pointer (&local_error, g_error_free);
-            }
-        }
-
-      if (g_list_model_get_n_items (G_LIST_MODEL (store)) > 0)
-        bz_state_info_set_available_updates (self->state, G_LIST_MODEL (store));
+      else if (g_list_model_get_n_items (store) > 0)
+        bz_state_info_set_available_updates (self->state, store);
     }
   else if (local_error != NULL)
     {
@@ -1105,7 +1084,6 @@ refresh_fiber (BzApplication *self)
   g_autoptr (GHashTable) eol_runtimes       = NULL;
   g_autoptr (GHashTable) sys_name_to_addons = NULL;
   g_autoptr (GHashTable) usr_name_to_addons = NULL;
-  g_autoptr (GPtrArray) cache_futures       = NULL;
   GtkWindow    *window                      = NULL;
   gboolean      result                      = FALSE;
   const GValue *sync_value                  = NULL;
@@ -1211,7 +1189,6 @@ refresh_fiber (BzApplication *self)
       g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
   usr_name_to_addons = g_hash_table_new_full (
       g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-  cache_futures = g_ptr_array_new_with_free_func (dex_unref);
 
   sync_future = bz_backend_retrieve_remote_entries (
       BZ_BACKEND (self->flatpak),
@@ -1300,7 +1277,7 @@ refresh_fiber (BzApplication *self)
                   g_autoptr (BzEntryGroup) new_group = NULL;
 
                   g_debug ("Creating new application group for id %s", id);
-                  new_group = bz_entry_group_new (self->entry_factory);
+                  new_group = bz_entry_group_new (self->entry_factory, self->cache);
 
                   g_list_store_append (self->groups, new_group);
                   g_hash_table_replace (self->ids_to_groups, g_strdup (id), g_object_ref (new_group));
@@ -1363,9 +1340,8 @@ refresh_fiber (BzApplication *self)
                            unique_id);
             }
 
-          g_ptr_array_add (
-              cache_futures,
-              bz_entry_cache_manager_add (self->cache, entry));
+          /* Only waits when the cache has fallen behind */
+          dex_await (bz_entry_cache_manager_queue (self->cache, entry), NULL);
 
           total++;
         }
@@ -1392,11 +1368,7 @@ refresh_fiber (BzApplication *self)
   bz_state_info_set_busy_step_label (self->state, busy_step_label);
   g_clear_pointer (&busy_step_label, g_free);
 
-  dex_await (dex_future_allv (
-                 (DexFuture *const *) cache_futures->pdata,
-                 cache_futures->len),
-             NULL);
-  g_clear_pointer (&cache_futures, g_ptr_array_unref);
+  dex_await (bz_entry_cache_manager_flush (self->cache), NULL);
 #ifdef __GLIBC__
   malloc_trim (0);
 #endif
@@ -1428,6 +1400,7 @@ refresh_fiber (BzApplication *self)
   gtk_filter_changed (GTK_FILTER (self->group_filter), GTK_FILTER_CHANGE_DIFFERENT);
   gtk_filter_changed (GTK_FILTER (self->application_filter), GTK_FILTER_CHANGE_DIFFERENT);
   bz_state_info_set_all_installed_entry_groups (self->state, G_LIST_MODEL (self->installed_apps));
+  dex_future_disown (bz_search_engine_save_index (self->search_engine));
 
   busy_step_label = g_strdup_printf (
       _ ("Completed initialization in %0.2f seconds"),
@@ -1459,9 +1432,10 @@ watch_backend_notifs_fiber (BzApplication *self)
           g_autoptr (GError) local_error          = NULL;
           g_autoptr (BzBackendNotification) notif = NULL;
           g_autoptr (GHashTable) installed_set    = NULL;
-          g_autoptr (GPtrArray) diff_reads        = NULL;
+          g_autoptr (GPtrArray) diff_ids          = NULL;
           GHashTableIter old_iter                 = { 0 };
           GHashTableIter new_iter                 = { 0 };
+          g_autoptr (GListModel) diff_entries     = NULL;
           g_autoptr (GPtrArray) diff_writes       = NULL;
 
           notif = dex_await_object (dex_channel_receive (channel), NULL);
@@ -1487,7 +1461,7 @@ watch_backend_notifs_fiber (BzApplication *self)
               continue;
             }
 
-          diff_reads = g_ptr_array_new_with_free_func (dex_unref);
+          diff_ids = g_ptr_array_new ();
 
           g_hash_table_iter_init (&old_iter, self->last_installed_set);
           for (;;)
@@ -1499,9 +1473,7 @@ watch_backend_notifs_fiber (BzApplication *self)
                 break;
 
               if (!g_hash_table_contains (installed_set, unique_id))
-                g_ptr_array_add (
-                    diff_reads,
-                    bz_entry_cache_manager_get (self->cache, unique_id));
+                g_ptr_array_add (diff_ids, unique_id);
             }
 
           g_hash_table_iter_init (&new_iter, installed_set);
@@ -1514,61 +1486,56 @@ watch_backend_notifs_fiber (BzApplication *self)
                 break;
 
               if (!g_hash_table_contains (self->last_installed_set, unique_id))
-                g_ptr_array_add (
-                    diff_reads,
-                    bz_entry_cache_manager_get (self->cache, unique_id));
+                g_ptr_array_add (diff_ids, unique_id);
             }
 
-          if (diff_reads->len > 0)
+          if (diff_ids->len > 0)
+            diff_entries = dex_await_object (
+                bz_entry_cache_manager_get_many (self->cache, diff_ids),
+                NULL);
+          if (diff_entries != NULL &&
+              g_list_model_get_n_items (diff_entries) > 0)
             {
-              dex_await (dex_future_allv (
-                             (DexFuture *const *) diff_reads->pdata,
-                             diff_reads->len),
-                         NULL);
+              guint n_entries = 0;
 
+              n_entries   = g_list_model_get_n_items (diff_entries);
               diff_writes = g_ptr_array_new_with_free_func (dex_unref);
-              for (guint i = 0; i < diff_reads->len; i++)
+              for (guint i = 0; i < n_entries; i++)
                 {
-                  DexFuture *future = NULL;
+                  g_autoptr (BzEntry) entry = NULL;
+                  const char   *id          = NULL;
+                  const char   *unique_id   = NULL;
+                  BzEntryGroup *group       = NULL;
+                  gboolean      installed   = FALSE;
+
+                  entry = g_list_model_get_item (diff_entries, i);
+                  id    = bz_entry_get_id (entry);
+                  group = g_hash_table_lookup (self->ids_to_groups, id);
+                  if (group != NULL)
+                    bz_entry_group_connect_living (group, entry);
+
+                  unique_id = bz_entry_get_unique_id (entry);
+                  installed = g_hash_table_contains (installed_set, unique_id);
+                  bz_entry_set_installed (entry, installed);
 
-                  future = g_ptr_array_index (diff_reads, i);
-                  if (dex_future_is_resolved (future))
+                  if (group != NULL)
                     {
-                      BzEntry      *entry     = NULL;
-                      const char   *id        = NULL;
-                      const char   *unique_id = NULL;
-                      BzEntryGroup *group     = NULL;
-                      gboolean      installed = FALSE;
-
-                      entry = g_value_get_object (dex_future_get_value (future, NULL));
-                      id    = bz_entry_get_id (entry);
-                      group = g_hash_table_lookup (self->ids_to_groups, id);
-                      if (group != NULL)
-                        bz_entry_group_connect_living (group, entry);
-
-                      unique_id = bz_entry_get_unique_id (entry);
-                      installed = g_hash_table_contains (installed_set, unique_id);
-                      bz_entry_set_installed (entry, installed);
-
-                      if (group != NULL)
-                        {
-                          gboolean found    = FALSE;
-                          guint    position = 0;
-
-                          found = g_list_store_find (self->installed_apps, group, &position);
-                          if (installed && !found)
-                            g_list_store_insert_sorted (
-                                self->installed_apps, group,
-                                (GCompareDataFunc) cmp_group, NULL);
-                          else if (!installed && found &&
-                                   bz_entry_group_get_removable (group) == 0)
-                            g_list_store_remove (self->installed_apps, position);
-                        }
-
-                      g_ptr_array_add (
-                          diff_writes,
-                          bz_entry_cache_manager_add (self->cache, entry));
+                      gboolean found    = FALSE;
+                      guint    position = 0;
+
+                      found = g_list_store_find (self->installed_apps, group, &position);
+                      if (installed && !found)
+                        g_list_store_insert_sorted (
+                            self->installed_apps, group,
+                            (GCompareDataFunc) cmp_group, NULL);
+                      else if (!installed && found &&
+                               bz_entry_group_get_removable (group) == 0)
+                        g_list_store_remove (self->installed_apps, position);
                     }
+
+                  g_ptr_array_add (
+                      diff_writes,
+                      bz_entry_cache_manager_add (self->cache, entry));
                 }
 
               dex_await (dex_future_allv (
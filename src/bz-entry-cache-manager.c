@@ -22,10 +22,91 @@
 #define PURESTORE_MODULE "entry-cache"
 
 #define MAX_CONCURRENT_WRITES             4
+#define CACHE_SHARDS                      16
 #define WATCH_CLEANUP_INTERVAL_MSEC       5000
 #define WATCH_RECACHE_INTERVAL_SEC_DOUBLE 4.0
 
+/* Bulk ingestion accepts at most this many entries
+ * ahead of the workers, which append what they
+ * serialize in batches of roughly this size
+ */
+#define INGEST_WORKERS        MAX_CONCURRENT_WRITES
+#define INGEST_QUEUE_CAPACITY 256
+#define INGEST_BATCH_BYTES    (4 * 1024 * 1024)
+
+/* How many entries a single multi-get
+ * reads from the store at once
+ */
+#define GET_MANY_CONCURRENCY MAX_CONCURRENT_WRITES
+
+/* Prefetch hints are served one at a time after a
+ * short delay, so hints for tiles only scrolled past
+ * are usually withdrawn before any work is done
+ */
+#define PREFETCH_QUEUE_MAX  64
+#define PREFETCH_DELAY_MSEC 150
+
+/* Matches the default of the max-memory-usage property */
+#define DEFAULT_MAX_MEMORY_USAGE (48 * 1024 * 1024)
+
+/* An entry takes up about this many times its serialized
+ * size once its strings are split out into fields, plus
+ * the objects it is made of. Textures loaded after it was
+ * last used are not accounted for, so the number of
+ * entries held is capped as well
+ */
+#define LRU_EXPANSION       2
+#define LRU_ENTRY_OVERHEAD  (16 * 1024)
+#define LRU_MAX_ENTRIES     512
+
+/* Bump whenever the layout of cached records changes,
+ * which throws out everything cached by older versions
+ */
+#define CACHE_FORMAT_VERSION 4
+#define STORE_FILENAME       "store"
+#define DICT_FILENAME        "store.dict"
+#define STORE_MAGIC          "PSCACHE"
+#define RECORD_MAGIC         0x50534552 /* PSER */
+
+/* Once the store is at least this large and half of it
+ * is made of superseded records, it is rewritten
+ */
+#define COMPACT_MIN_BYTES (8 * 1024 * 1024)
+
+/* Records appended while the store is being compacted
+ * are carried over in chunks of at most this size
+ */
+#define COMPACT_CHUNK_BYTES (64 * 1024)
+
+#define STORE_ALIGN(n) (((n) + 7) & ~(guint64) 7)
+
+/* Once this many entries are stored, a compression
+ * dictionary is trained on a sample of them
+ */
+#define DICT_MIN_SAMPLES  256
+#define DICT_SAMPLE_BYTES (8 * 1024 * 1024)
+#define DICT_MAX_BYTES    (112 * 1024)
+#define DICT_LEVEL        3
+
+/* How the payload of a record is encoded */
+enum
+{
+  STORE_CODEC_NONE = 0,
+  STORE_CODEC_ZSTD_DICT,
+};
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
 #include <malloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
 
 #include "bz-entry-cache-manager.h"
 #include "bz-env.h"
@@ -38,22 +119,164 @@
 G_DEFINE_QUARK (bz-entry-cache-error-quark, bz_entry_cache_error);
 /* clang-format on */
 
+/* Every cached entry lives in a single append-only store
+ * file. Writing an entry again appends a new record which
+ * supersedes the old one, and the cleanup sweep compacts
+ * the file once most of it is dead weight. The layout is
+ * a StoreFileHeader followed by records, each made of a
+ * StoreRecordHeader, the validator and the serialized
+ * entry, each padded to 8 bytes. The entry may be
+ * compressed with a dictionary kept next to the store
+ */
+typedef struct
+{
+  char    magic[8];
+  guint32 version;
+  guint32 reserved;
+} StoreFileHeader;
+G_STATIC_ASSERT (sizeof (StoreFileHeader) == 16);
+
+typedef struct
+{
+  guint32 magic;
+  guint32 payload_size;
+  guint16 validator_size;
+  guint16 codec;
+  guint32 raw_size;
+  char    key[32];
+  guint8  digest[16];
+} StoreRecordHeader;
+G_STATIC_ASSERT (sizeof (StoreRecordHeader) == 64);
+
 BZ_DEFINE_DATA (
-    ongoing_task,
-    OngoingTask,
+    store_segment,
+    StoreSegment,
     {
-      DexScheduler *scheduler;
-      DexPromise   *init;
+      char   *path;
+      int     fd;
+      guint64 size;
+      /* A read-only mapping of some prefix of the
+       * file, which reads are served out of
+       */
+      GBytes *mapped;
+    },
+    BZ_RELEASE_DATA (path, g_free);
+    BZ_RELEASE_DATA (mapped, g_bytes_unref);
+    if (self->fd >= 0) close (self->fd));
+
+/* Where the latest record of a key is, along with
+ * what is needed to tell if a new one would differ.
+ * A record is stale once the entry it was made from
+ * turned out to have a different validator, and its
+ * epoch is the last one it was written or confirmed in.
+ * It is verified once its contents matched the digest
+ */
+BZ_DEFINE_DATA (
+    store_record,
+    StoreRecord,
+    {
+      guint64  offset;
+      guint32  length;
+      guint32  payload_offset;
+      guint32  payload_size;
+      guint32  raw_size;
+      guint16  codec;
+      guint8   digest[16];
+      char    *validator;
+      gboolean stale;
+      guint    epoch;
+      gboolean verified;
+    },
+    BZ_RELEASE_DATA (validator, g_free));
+
+static void
+store_dict_free_codecs (gpointer cdict,
+                        gpointer ddict);
+
+/* A trained compression dictionary, which never
+ * changes for as long as the store exists
+ */
+BZ_DEFINE_DATA (
+    store_dict,
+    StoreDict,
+    {
+      gpointer cdict;
+      gpointer ddict;
+    },
+    store_dict_free_codecs (self->cdict, self->ddict));
+
+/* Records encoded back to back, waiting to be
+ * appended to the store with a single write
+ */
+BZ_DEFINE_DATA (
+    store_batch,
+    StoreBatch,
+    {
+      GByteArray *buffer;
+      GPtrArray  *keys;
+      GPtrArray  *records;
+      /* The position of the latest record of
+       * each key in the batch, offset by one
+       */
+      GHashTable *positions;
+    },
+    BZ_RELEASE_DATA (positions, g_hash_table_unref);
+    BZ_RELEASE_DATA (buffer, g_byte_array_unref);
+    BZ_RELEASE_DATA (keys, g_ptr_array_unref);
+    BZ_RELEASE_DATA (records, g_ptr_array_unref));
+
+/* An entry sent to the ingestion workers, along
+ * with the ticket it was queued under
+ */
+typedef struct
+{
+  BzEntry *entry;
+  guint    ticket;
+} IngestItem;
+
+static IngestItem *
+ingest_item_copy (IngestItem *item);
+
+static void
+ingest_item_free (IngestItem *item);
+
+G_DEFINE_BOXED_TYPE (IngestItem, ingest_item, ingest_item_copy, ingest_item_free);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (IngestItem, ingest_item_free);
+
+BZ_DEFINE_DATA (
+    ingest_waiter,
+    IngestWaiter,
+    {
+      guint       target;
+      DexPromise *promise;
+    },
+    BZ_RELEASE_DATA (promise, dex_unref));
+
+/* A recently used entry held onto strongly, sized
+ * by an estimate of how much memory it takes up
+ */
+BZ_DEFINE_DATA (
+    lru_entry,
+    LruEntry,
+    {
+      char    *key;
+      BzEntry *entry;
+      guint64  size;
+    },
+    BZ_RELEASE_DATA (key, g_free);
+    BZ_RELEASE_DATA (entry, g_object_unref));
 
+/* The tables of entries which are alive, being read
+ * and being written, for the keys hashing to a shard
+ */
+BZ_DEFINE_DATA (
+    cache_shard,
+    CacheShard,
+    {
       GHashTable *alive_hash;
       GHashTable *writing_hash;
       GHashTable *reading_hash;
 
-      BzGuard *ongoing_gates[MAX_CONCURRENT_WRITES];
-      GMutex   ongoing_mutexes[MAX_CONCURRENT_WRITES];
-      guint    ongoing_queued[MAX_CONCURRENT_WRITES];
-      GMutex   ongoing_queueing_mutex;
-
       BzGuard *alive_gate;
       GMutex   alive_mutex;
       BzGuard *reading_gate;
@@ -61,22 +284,111 @@ BZ_DEFINE_DATA (
       BzGuard *writing_gate;
       GMutex   writing_mutex;
     },
-    BZ_RELEASE_DATA (scheduler, dex_unref);
-    BZ_RELEASE_DATA (init, dex_unref);
     BZ_RELEASE_DATA (alive_hash, g_hash_table_unref);
     BZ_RELEASE_DATA (writing_hash, g_hash_table_unref);
     BZ_RELEASE_DATA (reading_hash, g_hash_table_unref);
-    for (guint i = 0; i < G_N_ELEMENTS (self->ongoing_gates); i++)
-        BZ_RELEASE_DATA (ongoing_gates[i], bz_guard_destroy);
-    for (guint i = 0; i < G_N_ELEMENTS (self->ongoing_mutexes); i++)
-        g_mutex_clear (&self->ongoing_mutexes[i]);
-    g_mutex_clear (&self->ongoing_queueing_mutex);
     BZ_RELEASE_DATA (alive_gate, bz_guard_destroy);
     BZ_RELEASE_DATA (reading_gate, bz_guard_destroy);
     BZ_RELEASE_DATA (writing_gate, bz_guard_destroy);
     g_mutex_clear (&self->alive_mutex);
     g_mutex_clear (&self->reading_mutex);
-    g_mutex_clear (&self->writing_mutex););
+    g_mutex_clear (&self->writing_mutex));
+
+BZ_DEFINE_DATA (
+    ongoing_task,
+    OngoingTask,
+    {
+      DexScheduler *scheduler;
+      DexPromise   *init;
+
+      CacheShardData *shards[CACHE_SHARDS];
+
+      StoreSegmentData *segment;
+      GHashTable       *store_index;
+      guint64           store_live_bytes;
+      gboolean          store_unsynced;
+      /* Records of a previous session start out in
+       * epoch 0, and each flush of a refresh ends one
+       */
+      guint store_epoch;
+      /* Set at most once, so it may be read
+       * atomically without the store guard
+       */
+      StoreDictData *store_dict;
+      gboolean       store_dict_attempted;
+      /* Everything put on disk versus the
+       * payloads which actually changed
+       */
+      guint64 store_written_bytes;
+      guint64 store_changed_bytes;
+
+      DexChannel     *ingest_channel;
+      StoreBatchData *ingest_batch;
+      /* Every ticket up to `ingest_done` is finished, and
+       * `ingest_finished` holds those finished past it
+       */
+      GPtrArray      *ingest_waiters;
+      GHashTable     *ingest_finished;
+      guint           ingest_queued;
+      guint           ingest_done;
+      guint           ingest_failed;
+      guint           ingest_flushed;
+
+      /* Most recently used at the head, the
+       * hash points into the queue
+       */
+      GQueue      lru_queue;
+      GHashTable *lru_hash;
+      guint64     lru_usage;
+      guint64     lru_budget;
+
+      /* Keys hinted at by the UI, with the most recent
+       * hint at the head. The hash points into the queue
+       */
+      GQueue      prefetch_queue;
+      GHashTable *prefetch_hash;
+      gboolean    prefetch_running;
+
+      BzGuard *ongoing_gates[MAX_CONCURRENT_WRITES];
+      GMutex   ongoing_mutexes[MAX_CONCURRENT_WRITES];
+      guint    ongoing_queued[MAX_CONCURRENT_WRITES];
+      GMutex   ongoing_queueing_mutex;
+
+      BzGuard *store_gate;
+      GMutex   store_mutex;
+      BzGuard *ingest_gate;
+      GMutex   ingest_mutex;
+      GMutex   ingest_ticket_mutex;
+      GMutex   lru_mutex;
+      GMutex   prefetch_mutex;
+    },
+    BZ_RELEASE_DATA (scheduler, dex_unref);
+    BZ_RELEASE_DATA (init, dex_unref);
+    for (guint i = 0; i < G_N_ELEMENTS (self->shards); i++)
+        BZ_RELEASE_DATA (shards[i], cache_shard_data_unref);
+    BZ_RELEASE_DATA (segment, store_segment_data_unref);
+    BZ_RELEASE_DATA (store_index, g_hash_table_unref);
+    BZ_RELEASE_DATA (store_dict, store_dict_data_unref);
+    BZ_RELEASE_DATA (ingest_channel, dex_unref);
+    BZ_RELEASE_DATA (ingest_batch, store_batch_data_unref);
+    BZ_RELEASE_DATA (ingest_waiters, g_ptr_array_unref);
+    BZ_RELEASE_DATA (ingest_finished, g_hash_table_unref);
+    BZ_RELEASE_DATA (lru_hash, g_hash_table_unref);
+    g_queue_clear_full (&self->lru_queue, lru_entry_data_unref);
+    BZ_RELEASE_DATA (prefetch_hash, g_hash_table_unref);
+    g_queue_clear_full (&self->prefetch_queue, g_free);
+    for (guint i = 0; i < G_N_ELEMENTS (self->ongoing_gates); i++)
+        BZ_RELEASE_DATA (ongoing_gates[i], bz_guard_destroy);
+    for (guint i = 0; i < G_N_ELEMENTS (self->ongoing_mutexes); i++)
+        g_mutex_clear (&self->ongoing_mutexes[i]);
+    g_mutex_clear (&self->ongoing_queueing_mutex);
+    BZ_RELEASE_DATA (store_gate, bz_guard_destroy);
+    BZ_RELEASE_DATA (ingest_gate, bz_guard_destroy);
+    g_mutex_clear (&self->store_mutex);
+    g_mutex_clear (&self->ingest_mutex);
+    g_mutex_clear (&self->ingest_ticket_mutex);
+    g_mutex_clear (&self->lru_mutex);
+    g_mutex_clear (&self->prefetch_mutex););
 
 struct _BzEntryCacheManager
 {
@@ -85,10 +397,10 @@ struct _BzEntryCacheManager
   guint64 max_memory_usage;
 
   DexScheduler *scheduler;
-  guint64       memory_usage;
 
   OngoingTaskData *task_data;
   DexFuture       *watch_task;
+  GPtrArray       *ingest_tasks;
 };
 
 G_DEFINE_FINAL_TYPE (BzEntryCacheManager, bz_entry_cache_manager, G_TYPE_OBJECT);
@@ -113,6 +425,91 @@ watch_cb (DexFuture       *future,
 static DexFuture *
 watch_work_fiber (OngoingTaskData *task_data);
 
+static CacheShardData *
+shard_for_key (OngoingTaskData *task_data,
+               const char      *key);
+
+static gboolean
+store_open (OngoingTaskData *task_data,
+            GError         **error);
+
+static gboolean
+store_is_current (OngoingTaskData *task_data,
+                  const char      *key,
+                  const char      *validator,
+                  const guint8    *digest);
+
+static gboolean
+store_append (OngoingTaskData *task_data,
+              const char      *key,
+              const char      *validator,
+              const guint8    *digest,
+              GBytes          *bytes,
+              GError         **error);
+
+static StoreBatchData *
+store_batch_new (void);
+
+static void
+store_batch_clear (StoreBatchData *batch);
+
+static gboolean
+store_batch_encode (StoreBatchData *batch,
+                    const char     *key,
+                    const char     *validator,
+                    const guint8   *digest,
+                    guint16         codec,
+                    gsize           raw_size,
+                    GBytes         *payload,
+                    GError        **error);
+
+static GBytes *
+store_encode_payload (OngoingTaskData *task_data,
+                      GBytes          *bytes,
+                      guint16         *codec);
+
+static StoreDictData *
+store_dict_load (const char *path);
+
+static void
+store_dict_maybe_train (OngoingTaskData *task_data);
+
+static GBytes *
+store_dict_compress (StoreDictData *dict,
+                     GBytes        *bytes);
+
+static GBytes *
+store_dict_decompress (StoreDictData *dict,
+                       GBytes        *bytes,
+                       gsize          raw_size,
+                       GError       **error);
+
+static gboolean
+store_append_batch (OngoingTaskData *task_data,
+                    StoreBatchData  *batch,
+                    GPtrArray       *superseded,
+                    GError         **error);
+
+static GBytes *
+store_read (OngoingTaskData *task_data,
+            const char      *key,
+            GError         **error);
+
+static void
+store_prune (OngoingTaskData *task_data,
+             GPtrArray       *pruned);
+
+static void
+store_maintain (OngoingTaskData *task_data);
+
+static void
+store_sync (OngoingTaskData *task_data);
+
+static void
+store_take_write_stats (OngoingTaskData *task_data,
+                        guint64         *written_bytes,
+                        guint64         *changed_bytes);
+
 BZ_DEFINE_DATA (
     living_entry,
     LivingEntry,
@@ -121,12 +518,29 @@ BZ_DEFINE_DATA (
       BzGuard *gate;
       GMutex   mutex;
       GTimer  *cached;
+      /* The generation of the entry as it is
+       * in the store, if `persisted` is set
+       */
+      guint    generation;
+      gboolean persisted;
     },
     BZ_RELEASE_DATA (gate, bz_guard_destroy);
     g_mutex_clear (&self->mutex);
     g_weak_ref_clear (&self->wr);
     BZ_RELEASE_DATA (cached, g_timer_destroy));
 
+BZ_DEFINE_DATA (
+    ingest_send,
+    IngestSend,
+    {
+      OngoingTaskData *task_data;
+      guint            ticket;
+    },
+    BZ_RELEASE_DATA (task_data, ongoing_task_data_unref))
+static DexFuture *
+ingest_send_rejected_cb (DexFuture      *future,
+                         IngestSendData *data);
+
 BZ_DEFINE_DATA (
     write_task,
     WriteTask,
@@ -153,13 +567,78 @@ BZ_DEFINE_DATA (
 static DexFuture *
 read_task_fiber (ReadTaskData *data);
 
+BZ_DEFINE_DATA (
+    get_many_task,
+    GetManyTask,
+    {
+      OngoingTaskData *task_data;
+      GPtrArray       *unique_ids;
+    },
+    BZ_RELEASE_DATA (task_data, ongoing_task_data_unref);
+    BZ_RELEASE_DATA (unique_ids, g_ptr_array_unref))
+static DexFuture *
+get_many_fiber (GetManyTaskData *data);
+
+static DexFuture *
+prefetch_fiber (OngoingTaskData *task_data);
+
+static GBytes *
+serialize_entry (BzEntry     *entry,
+                 const char **validator,
+                 guint8      *digest);
+
+static DexFuture *
+ingest_worker_fiber (OngoingTaskData *task_data);
+
+static BzEntry *
+lru_lookup (OngoingTaskData *task_data,
+            const char      *key);
+
+static void
+lru_insert (OngoingTaskData *task_data,
+            const char      *key,
+            BzEntry         *entry,
+            guint64          raw_size);
+
+static void
+lru_set_budget (OngoingTaskData *task_data,
+                guint64          budget);
+
+static void
+lru_remove (OngoingTaskData *task_data,
+            const char      *key);
+
+static DexFuture *
+ingest_flush_fiber (OngoingTaskData *task_data);
+
+static void
+ingest_finish (OngoingTaskData *task_data,
+               guint            ticket,
+               gboolean         succeeded);
+
+static gboolean
+ingest_entry (OngoingTaskData *task_data,
+              BzEntry         *entry,
+              GError         **error);
+
+static void
+forget_superseded (OngoingTaskData *task_data,
+                   GPtrArray       *keys);
+
 static void
 bz_entry_cache_manager_dispose (GObject *object)
 {
   BzEntryCacheManager *self = BZ_ENTRY_CACHE_MANAGER (object);
 
+  /* Lets the ingestion workers finish what is
+   * queued and then return
+   */
+  if (self->task_data != NULL)
+    dex_channel_close_send (self->task_data->ingest_channel);
+
   dex_clear (&self->scheduler);
   dex_clear (&self->watch_task);
+  g_clear_pointer (&self->ingest_tasks, g_ptr_array_unref);
   g_clear_pointer (&self->task_data, ongoing_task_data_unref);
 
   G_OBJECT_CLASS (bz_entry_cache_manager_parent_class)->dispose (object);
@@ -214,7 +693,7 @@ bz_entry_cache_manager_class_init (BzEntryCacheManagerClass *klass)
       g_param_spec_uint64 (
           "max-memory-usage",
           NULL, NULL,
-          0, G_MAXUINT64, 0xccccccc,
+          0, G_MAXUINT64, DEFAULT_MAX_MEMORY_USAGE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
 
   g_object_class_install_properties (object_class, LAST_PROP, props);
@@ -229,24 +708,48 @@ bz_entry_cache_manager_init (BzEntryCacheManager *self)
   if (g_once_init_enter_pointer (&global_scheduler))
     g_once_init_leave_pointer (&global_scheduler, dex_thread_pool_scheduler_new ());
 
-  self->scheduler    = dex_ref (global_scheduler);
-  self->memory_usage = 0;
-
-  task_data             = ongoing_task_data_new ();
-  task_data->scheduler  = dex_ref (self->scheduler);
-  task_data->init       = dex_promise_new ();
-  task_data->alive_hash = g_hash_table_new_full (
-      g_str_hash, g_str_equal, g_free, living_entry_data_unref);
-  task_data->writing_hash = g_hash_table_new_full (
-      g_str_hash, g_str_equal, g_free, dex_unref);
-  task_data->reading_hash = g_hash_table_new_full (
-      g_str_hash, g_str_equal, g_free, dex_unref);
+  self->scheduler        = dex_ref (global_scheduler);
+  self->max_memory_usage = DEFAULT_MAX_MEMORY_USAGE;
+
+  task_data            = ongoing_task_data_new ();
+  task_data->scheduler = dex_ref (self->scheduler);
+  task_data->init      = dex_promise_new ();
+  for (guint i = 0; i < G_N_ELEMENTS (task_data->shards); i++)
+    {
+      g_autoptr (CacheShardData) shard = NULL;
+
+      shard             = cache_shard_data_new ();
+      shard->alive_hash = g_hash_table_new_full (
+          g_str_hash, g_str_equal, g_free, living_entry_data_unref);
+      shard->writing_hash = g_hash_table_new_full (
+          g_str_hash, g_str_equal, g_free, dex_unref);
+      shard->reading_hash = g_hash_table_new_full (
+          g_str_hash, g_str_equal, g_free, dex_unref);
+      g_mutex_init (&shard->alive_mutex);
+      g_mutex_init (&shard->reading_mutex);
+      g_mutex_init (&shard->writing_mutex);
+      task_data->shards[i] = g_steal_pointer (&shard);
+    }
+  task_data->store_index = g_hash_table_new_full (
+      g_str_hash, g_str_equal, g_free, store_record_data_unref);
+  task_data->store_epoch = 1;
+  task_data->ingest_channel  = dex_channel_new (INGEST_QUEUE_CAPACITY);
+  task_data->ingest_batch    = store_batch_new ();
+  task_data->ingest_waiters  = g_ptr_array_new_with_free_func (ingest_waiter_data_unref);
+  task_data->ingest_finished = g_hash_table_new (g_direct_hash, g_direct_equal);
+  task_data->lru_hash        = g_hash_table_new (g_str_hash, g_str_equal);
+  task_data->lru_budget      = self->max_memory_usage;
+  task_data->prefetch_hash   = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&task_data->lru_queue);
+  g_queue_init (&task_data->prefetch_queue);
   for (guint i = 0; i < G_N_ELEMENTS (task_data->ongoing_mutexes); i++)
     g_mutex_init (&task_data->ongoing_mutexes[i]);
   g_mutex_init (&task_data->ongoing_queueing_mutex);
-  g_mutex_init (&task_data->alive_mutex);
-  g_mutex_init (&task_data->reading_mutex);
-  g_mutex_init (&task_data->writing_mutex);
+  g_mutex_init (&task_data->store_mutex);
+  g_mutex_init (&task_data->ingest_mutex);
+  g_mutex_init (&task_data->ingest_ticket_mutex);
+  g_mutex_init (&task_data->lru_mutex);
+  g_mutex_init (&task_data->prefetch_mutex);
   self->task_data = g_steal_pointer (&task_data);
 
   self->watch_task = dex_scheduler_spawn (
@@ -255,6 +758,17 @@ bz_entry_cache_manager_init (BzEntryCacheManager *self)
       (DexFiberFunc) watch_init_fiber,
       ongoing_task_data_ref (self->task_data),
       ongoing_task_data_unref);
+
+  self->ingest_tasks = g_ptr_array_new_with_free_func (dex_unref);
+  for (guint i = 0; i < INGEST_WORKERS; i++)
+    g_ptr_array_add (
+        self->ingest_tasks,
+        dex_scheduler_spawn (
+            self->scheduler,
+            bz_get_dex_stack_size (),
+            (DexFiberFunc) ingest_worker_fiber,
+            ongoing_task_data_ref (self->task_data),
+            ongoing_task_data_unref));
 }
 
 BzEntryCacheManager *
@@ -277,6 +791,7 @@ bz_entry_cache_manager_set_max_memory_usage (BzEntryCacheManager *self,
   g_return_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
 
   self->max_memory_usage = max_memory_usage;
+  lru_set_budget (self->task_data, max_memory_usage);
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_MAX_MEMORY_USAGE]);
 }
@@ -306,11 +821,58 @@ bz_entry_cache_manager_add (BzEntryCacheManager *self,
   return g_steal_pointer (&future);
 }
 
+DexFuture *
+bz_entry_cache_manager_queue (BzEntryCacheManager *self,
+                              BzEntry             *entry)
+{
+  g_autoptr (IngestItem) item     = NULL;
+  g_autoptr (IngestSendData) send = NULL;
+  DexFuture *future               = NULL;
+
+  dex_return_error_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+  dex_return_error_if_fail (BZ_IS_ENTRY (entry));
+  dex_return_error_if_fail (!bz_entry_is_holding (entry));
+
+  /* Ticketed before it is sent, so a flush
+   * always waits for it to be written
+   */
+  item         = g_new0 (IngestItem, 1);
+  item->entry  = g_object_ref (entry);
+  item->ticket = g_atomic_int_add (&self->task_data->ingest_queued, 1) + 1;
+
+  send            = ingest_send_data_new ();
+  send->task_data = ongoing_task_data_ref (self->task_data);
+  send->ticket    = item->ticket;
+
+  future = dex_channel_send (
+      self->task_data->ingest_channel,
+      dex_future_new_take_boxed (ingest_item_get_type (), g_steal_pointer (&item)));
+  return dex_future_catch (
+      future,
+      (DexFutureCallback) ingest_send_rejected_cb,
+      g_steal_pointer (&send),
+      ingest_send_data_unref);
+}
+
+DexFuture *
+bz_entry_cache_manager_flush (BzEntryCacheManager *self)
+{
+  dex_return_error_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+
+  return dex_scheduler_spawn (
+      self->scheduler,
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) ingest_flush_fiber,
+      ongoing_task_data_ref (self->task_data),
+      ongoing_task_data_unref);
+}
+
 DexFuture *
 bz_entry_cache_manager_get (BzEntryCacheManager *self,
                             const char          *unique_id)
 {
   g_autoptr (ReadTaskData) data = NULL;
+  g_autoptr (BzEntry) recent    = NULL;
   g_autoptr (DexFuture) future  = NULL;
 
   dex_return_error_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
@@ -320,6 +882,13 @@ bz_entry_cache_manager_get (BzEntryCacheManager *self,
   data->task_data          = ongoing_task_data_ref (self->task_data);
   data->unique_id_checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, unique_id, -1);
 
+  /* Recently used entries are handed
+   * back without leaving this thread
+   */
+  recent = lru_lookup (self->task_data, data->unique_id_checksum);
+  if (recent != NULL)
+    return dex_future_new_for_object (recent);
+
   future = dex_scheduler_spawn (
       self->scheduler,
       bz_get_dex_stack_size (),
@@ -329,12 +898,126 @@ bz_entry_cache_manager_get (BzEntryCacheManager *self,
   return g_steal_pointer (&future);
 }
 
+DexFuture *
+bz_entry_cache_manager_get_many (BzEntryCacheManager *self,
+                                 GPtrArray           *unique_ids)
+{
+  g_autoptr (GetManyTaskData) data = NULL;
+
+  dex_return_error_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+  dex_return_error_if_fail (unique_ids != NULL);
+
+  data             = get_many_task_data_new ();
+  data->task_data  = ongoing_task_data_ref (self->task_data);
+  data->unique_ids = g_ptr_array_new_full (unique_ids->len, g_free);
+  for (guint i = 0; i < unique_ids->len; i++)
+    g_ptr_array_add (data->unique_ids, g_strdup (g_ptr_array_index (unique_ids, i)));
+
+  return dex_scheduler_spawn (
+      self->scheduler,
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) get_many_fiber,
+      get_many_task_data_ref (data),
+      get_many_task_data_unref);
+}
+
+/* Hints that `unique_id` is likely to be asked for soon, for
+ * instance because a tile for it was bound or hovered. It is
+ * read into memory in the background, ahead of older hints
+ */
+void
+bz_entry_cache_manager_prefetch (BzEntryCacheManager *self,
+                                 const char          *unique_id)
+{
+  OngoingTaskData *task_data      = NULL;
+  g_autofree char *key            = NULL;
+  g_autoptr (BzEntry) recent      = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  GList   *link                   = NULL;
+  gboolean spawn                  = FALSE;
+
+  g_return_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+  g_return_if_fail (unique_id != NULL);
+
+  task_data = self->task_data;
+  key       = g_compute_checksum_for_string (G_CHECKSUM_MD5, unique_id, -1);
+
+  recent = lru_lookup (task_data, key);
+  if (recent != NULL)
+    return;
+
+  locker = g_mutex_locker_new (&task_data->prefetch_mutex);
+  link   = g_hash_table_lookup (task_data->prefetch_hash, key);
+  if (link != NULL)
+    {
+      g_queue_unlink (&task_data->prefetch_queue, link);
+      g_queue_push_head_link (&task_data->prefetch_queue, link);
+    }
+  else
+    {
+      g_queue_push_head (&task_data->prefetch_queue, g_steal_pointer (&key));
+      g_hash_table_replace (
+          task_data->prefetch_hash,
+          task_data->prefetch_queue.head->data,
+          task_data->prefetch_queue.head);
+
+      while (task_data->prefetch_queue.length > PREFETCH_QUEUE_MAX)
+        {
+          g_autofree char *oldest = NULL;
+
+          oldest = g_queue_pop_tail (&task_data->prefetch_queue);
+          g_hash_table_remove (task_data->prefetch_hash, oldest);
+        }
+    }
+
+  spawn                       = !task_data->prefetch_running;
+  task_data->prefetch_running = TRUE;
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  if (spawn)
+    dex_future_disown (dex_scheduler_spawn (
+        self->scheduler,
+        bz_get_dex_stack_size (),
+        (DexFiberFunc) prefetch_fiber,
+        ongoing_task_data_ref (task_data),
+        ongoing_task_data_unref));
+}
+
+/* Withdraws a hint given with bz_entry_cache_manager_prefetch(),
+ * for instance because its tile was scrolled out of view
+ */
+void
+bz_entry_cache_manager_cancel_prefetch (BzEntryCacheManager *self,
+                                        const char          *unique_id)
+{
+  OngoingTaskData *task_data      = NULL;
+  g_autofree char *key            = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  GList *link                     = NULL;
+
+  g_return_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+  g_return_if_fail (unique_id != NULL);
+
+  task_data = self->task_data;
+  key       = g_compute_checksum_for_string (G_CHECKSUM_MD5, unique_id, -1);
+
+  locker = g_mutex_locker_new (&task_data->prefetch_mutex);
+  link   = g_hash_table_lookup (task_data->prefetch_hash, key);
+  if (link != NULL)
+    {
+      g_hash_table_remove (task_data->prefetch_hash, key);
+      g_free (link->data);
+      g_queue_delete_link (&task_data->prefetch_queue, link);
+    }
+}
+
 static DexFuture *
 write_task_fiber (WriteTaskData *data)
 {
   OngoingTaskData *task_data           = data->task_data;
   char            *unique_id_checksum  = data->unique_id_checksum;
   BzEntry         *entry               = data->entry;
+  CacheShardData  *shard               = NULL;
   g_autoptr (GError) local_error       = NULL;
   g_autoptr (BzGuard) slot_guard       = NULL;
   g_autoptr (BzGuard) other_guard      = NULL;
@@ -344,15 +1027,12 @@ write_task_fiber (WriteTaskData *data)
   DexFuture *writing_future            = NULL;
   g_autoptr (LivingEntryData) living   = NULL;
   g_autoptr (DexPromise) promise       = NULL;
-  g_autoptr (GVariantBuilder) builder  = NULL;
-  g_autoptr (GVariant) variant         = NULL;
   g_autoptr (GBytes) bytes             = NULL;
-  g_autofree char *main_cache          = NULL;
-  g_autoptr (GFile) parent_file        = NULL;
-  g_autoptr (GFile) save_file          = NULL;
-  g_autoptr (GFileOutputStream) output = NULL;
-  gssize   bytes_written               = 0;
-  gboolean result                      = FALSE;
+  const char *validator                = NULL;
+  guint8      digest[16]               = { 0 };
+  guint       generation               = 0;
+  gboolean    result                   = FALSE;
+  gboolean    superseded               = FALSE;
   g_autoptr (GError) ret_error         = NULL;
 
   if (!BZ_IS_FLATPAK_ENTRY (entry))
@@ -391,11 +1071,12 @@ write_task_fiber (WriteTaskData *data)
 
   dex_await (dex_ref (task_data->init), NULL);
 
+  shard = shard_for_key (task_data, unique_id_checksum);
   BZ_BEGIN_GUARD_WITH_CONTEXT (&other_guard,
-                               &task_data->writing_mutex,
-                               &task_data->writing_gate);
+                               &shard->writing_mutex,
+                               &shard->writing_gate);
   {
-    writing_future = g_hash_table_lookup (task_data->writing_hash, unique_id_checksum);
+    writing_future = g_hash_table_lookup (shard->writing_hash, unique_id_checksum);
     if (writing_future != NULL)
       return dex_future_new_reject (
           BZ_ENTRY_CACHE_ERROR,
@@ -404,17 +1085,17 @@ write_task_fiber (WriteTaskData *data)
           unique_id_checksum);
 
     promise = dex_promise_new ();
-    g_hash_table_replace (task_data->writing_hash,
+    g_hash_table_replace (shard->writing_hash,
                           g_strdup (unique_id_checksum),
                           dex_ref (promise));
   }
   bz_clear_guard (&other_guard);
 
   BZ_BEGIN_GUARD_WITH_CONTEXT (&other_guard,
-                               &task_data->alive_mutex,
-                               &task_data->alive_gate);
+                               &shard->alive_mutex,
+                               &shard->alive_gate);
   {
-    living = g_hash_table_lookup (task_data->alive_hash, unique_id_checksum);
+    living = g_hash_table_lookup (shard->alive_hash, unique_id_checksum);
     if (living != NULL)
       living_entry_data_ref (living);
     else
@@ -423,7 +1104,7 @@ write_task_fiber (WriteTaskData *data)
         g_weak_ref_init (&living->wr, NULL);
         g_mutex_init (&living->mutex);
         living->cached = g_timer_new ();
-        g_hash_table_replace (task_data->alive_hash,
+        g_hash_table_replace (shard->alive_hash,
                               g_strdup (unique_id_checksum),
                               living_entry_data_ref (living));
       }
@@ -434,87 +1115,65 @@ write_task_fiber (WriteTaskData *data)
                                &living->mutex,
                                &living->gate);
   {
-    builder = g_variant_builder_new (G_VARIANT_TYPE_VARDICT);
-    bz_serializable_serialize (BZ_SERIALIZABLE (entry), builder);
-    variant = g_variant_builder_end (builder);
-    bytes   = g_variant_get_data_as_bytes (variant);
-
-    main_cache  = bz_dup_module_dir ();
-    parent_file = g_file_new_for_path (main_cache);
-    result      = g_file_make_directory_with_parents (parent_file, NULL, &local_error);
-    if (!result)
+    /* Taken first so a change made while
+     * serializing is picked up next sweep
+     */
+    generation = bz_entry_get_generation (entry);
+
+    bytes = serialize_entry (entry, &validator, digest);
+
+    /* Refreshing hands us every entry again,
+     * but only the ones which changed are written
+     */
+    if (!store_is_current (task_data, unique_id_checksum, validator, digest))
       {
-        if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
-          g_clear_pointer (&local_error, g_error_free);
-        else
+        g_autoptr (BzEntry) living_entry = NULL;
+
+        result = store_append (task_data, unique_id_checksum, validator, digest, bytes, &local_error);
+        if (!result)
           {
             ret_error = g_error_new (
                 BZ_ENTRY_CACHE_ERROR,
                 BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
-                "Failed to make parent directory '%s' when caching '%s': %s",
-                main_cache, unique_id_checksum, local_error->message);
+                "Failed to append '%s' to the store: %s",
+                unique_id_checksum, local_error->message);
             goto done;
           }
-      }
-    save_file = g_file_new_build_filename (main_cache, unique_id_checksum, NULL);
-
-    output = g_file_replace (
-        save_file,
-        NULL,
-        FALSE,
-        G_FILE_CREATE_REPLACE_DESTINATION,
-        NULL,
-        &local_error);
-    if (output == NULL)
-      {
-        ret_error = g_error_new (
-            BZ_ENTRY_CACHE_ERROR,
-            BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
-            "Failed to open write stream when caching '%s': %s",
-            unique_id_checksum, local_error->message);
-        goto done;
-      }
-
-    bytes_written = g_output_stream_write_bytes (G_OUTPUT_STREAM (output), bytes, NULL, &local_error);
-    if (bytes_written < 0)
-      {
-        ret_error = g_error_new (
-            BZ_ENTRY_CACHE_ERROR,
-            BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
-            "Failed to write data to stream when caching '%s': %s",
-            unique_id_checksum, local_error->message);
-        goto done;
-      }
 
-    result = g_output_stream_close (G_OUTPUT_STREAM (output), NULL, &local_error);
-    if (!result)
-      {
-        ret_error = g_error_new (
-            BZ_ENTRY_CACHE_ERROR,
-            BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
-            "Failed to close stream when caching '%s': %s",
-            unique_id_checksum, local_error->message);
-        goto done;
+        /* A different object handed out earlier is now stale */
+        living_entry = g_weak_ref_get (&living->wr);
+        superseded   = living_entry != NULL && living_entry != entry;
       }
 
+    living->generation = generation;
+    living->persisted  = TRUE;
     g_timer_start (living->cached);
   }
 done:
   bz_clear_guard (&slot_guard);
 
   BZ_BEGIN_GUARD_WITH_CONTEXT (&other_guard,
-                               &task_data->writing_mutex,
-                               &task_data->writing_gate);
+                               &shard->writing_mutex,
+                               &shard->writing_gate);
   {
     if (ret_error != NULL)
       dex_promise_reject (promise, g_error_copy (ret_error));
     else
       dex_promise_resolve_boolean (promise, TRUE);
 
-    g_hash_table_remove (task_data->writing_hash, unique_id_checksum);
+    g_hash_table_remove (shard->writing_hash, unique_id_checksum);
   }
   bz_clear_guard (&other_guard);
 
+  if (superseded)
+    {
+      g_autoptr (GPtrArray) keys = NULL;
+
+      keys = g_ptr_array_new ();
+      g_ptr_array_add (keys, unique_id_checksum);
+      forget_superseded (task_data, keys);
+    }
+
   if (ret_error != NULL)
     return dex_future_new_for_error (g_steal_pointer (&ret_error));
   else
@@ -526,6 +1185,7 @@ read_task_fiber (ReadTaskData *data)
 {
   OngoingTaskData *task_data           = data->task_data;
   char            *unique_id_checksum  = data->unique_id_checksum;
+  CacheShardData  *shard               = NULL;
   g_autoptr (GError) local_error       = NULL;
   g_autoptr (BzGuard) guard            = NULL;
   g_autoptr (GMutexLocker) locker      = NULL;
@@ -533,9 +1193,6 @@ read_task_fiber (ReadTaskData *data)
   g_autoptr (LivingEntryData) living   = NULL;
   DexFuture *reading_future            = NULL;
   g_autoptr (DexPromise) promise       = NULL;
-  g_autofree char *main_cache          = NULL;
-  g_autofree char *path                = NULL;
-  g_autoptr (GFile) file               = NULL;
   g_autoptr (GBytes) bytes             = NULL;
   g_autoptr (GVariant) variant         = NULL;
   g_autoptr (BzFlatpakEntry) entry     = NULL;
@@ -544,11 +1201,12 @@ read_task_fiber (ReadTaskData *data)
 
   dex_await (dex_ref (task_data->init), NULL);
 
+  shard = shard_for_key (task_data, unique_id_checksum);
   BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
-                               &task_data->writing_mutex,
-                               &task_data->writing_gate);
+                               &shard->writing_mutex,
+                               &shard->writing_gate);
   {
-    writing_future = g_hash_table_lookup (task_data->writing_hash, unique_id_checksum);
+    writing_future = g_hash_table_lookup (shard->writing_hash, unique_id_checksum);
     if (writing_future != NULL)
       {
         dex_ref (writing_future);
@@ -559,24 +1217,24 @@ read_task_fiber (ReadTaskData *data)
   bz_clear_guard (&guard);
 
   BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
-                               &task_data->reading_mutex,
-                               &task_data->reading_gate);
+                               &shard->reading_mutex,
+                               &shard->reading_gate);
   {
-    reading_future = g_hash_table_lookup (task_data->reading_hash, unique_id_checksum);
+    reading_future = g_hash_table_lookup (shard->reading_hash, unique_id_checksum);
     if (reading_future != NULL)
       return dex_ref (reading_future);
     promise = dex_promise_new ();
-    g_hash_table_replace (task_data->reading_hash,
+    g_hash_table_replace (shard->reading_hash,
                           g_strdup (unique_id_checksum),
                           dex_ref (promise));
   }
   bz_clear_guard (&guard);
 
   BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
-                               &task_data->alive_mutex,
-                               &task_data->alive_gate);
+                               &shard->alive_mutex,
+                               &shard->alive_gate);
   {
-    living = g_hash_table_lookup (task_data->alive_hash, unique_id_checksum);
+    living = g_hash_table_lookup (shard->alive_hash, unique_id_checksum);
     if (living != NULL)
       {
         g_autoptr (BzEntry) living_entry = NULL;
@@ -590,13 +1248,14 @@ read_task_fiber (ReadTaskData *data)
           {
             bz_clear_guard (&guard);
             BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
-                                         &task_data->reading_mutex,
-                                         &task_data->reading_gate);
+                                         &shard->reading_mutex,
+                                         &shard->reading_gate);
             {
-              g_hash_table_remove (task_data->reading_hash, unique_id_checksum);
+              g_hash_table_remove (shard->reading_hash, unique_id_checksum);
             }
             bz_clear_guard (&guard);
 
+            lru_insert (task_data, unique_id_checksum, living_entry, 0);
             dex_promise_resolve_object (promise, g_object_ref (living_entry));
             return dex_future_new_for_object (living_entry);
           }
@@ -608,7 +1267,7 @@ read_task_fiber (ReadTaskData *data)
         g_mutex_init (&living->mutex);
         living->cached = g_timer_new ();
 
-        g_hash_table_replace (task_data->alive_hash,
+        g_hash_table_replace (shard->alive_hash,
                               g_strdup (unique_id_checksum),
                               living_entry_data_ref (living));
         bz_clear_guard (&guard);
@@ -619,56 +1278,58 @@ read_task_fiber (ReadTaskData *data)
 
   /* living data was guarded */
 
-  main_cache = bz_dup_module_dir ();
-  path       = g_build_filename (main_cache, unique_id_checksum, NULL);
-  file       = g_file_new_for_path (path);
-
-  bytes = g_file_load_bytes (file, NULL, NULL, &local_error);
+  bytes = store_read (task_data, unique_id_checksum, &local_error);
   if (bytes == NULL)
     {
       ret_error = g_error_new (
           BZ_ENTRY_CACHE_ERROR,
           BZ_ENTRY_CACHE_ERROR_DECACHE_FAILED,
-          "Failed to de-cache variant from file: %s",
+          "Failed to de-cache variant from store: %s",
           local_error->message);
       goto done;
     }
 
-  variant = g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE);
+  entry   = g_object_new (BZ_TYPE_FLATPAK_ENTRY, NULL);
+  variant = g_variant_new_from_bytes (
+      bz_serializable_get_compact_type (BZ_SERIALIZABLE (entry)),
+      bytes, FALSE);
   if (variant == NULL)
     {
       ret_error = g_error_new (
           BZ_ENTRY_CACHE_ERROR,
           BZ_ENTRY_CACHE_ERROR_DECACHE_FAILED,
-          "Failed to interpret variant from %s: %s",
-          path, local_error->message);
+          "Failed to interpret variant for %s",
+          unique_id_checksum);
       goto done;
     }
 
-  entry  = g_object_new (BZ_TYPE_FLATPAK_ENTRY, NULL);
-  result = bz_serializable_deserialize (BZ_SERIALIZABLE (entry), variant, &local_error);
+  result = bz_serializable_deserialize_compact (BZ_SERIALIZABLE (entry), variant, &local_error);
   if (!result)
     {
       ret_error = g_error_new (
           BZ_ENTRY_CACHE_ERROR,
           BZ_ENTRY_CACHE_ERROR_DECACHE_FAILED,
-          "Failed to deserialize entry from %s: %s",
-          path, local_error->message);
+          "Failed to deserialize entry %s: %s",
+          unique_id_checksum, local_error->message);
       goto done;
     }
   g_weak_ref_init (&living->wr, entry);
+  living->generation = bz_entry_get_generation (BZ_ENTRY (entry));
+  living->persisted  = TRUE;
+  g_timer_start (living->cached);
+  lru_insert (task_data, unique_id_checksum, BZ_ENTRY (entry), g_bytes_get_size (bytes));
 
 done:
   BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
-                               &task_data->reading_mutex,
-                               &task_data->reading_gate);
+                               &shard->reading_mutex,
+                               &shard->reading_gate);
   {
     if (ret_error != NULL)
       dex_promise_reject (promise, g_error_copy (ret_error));
     else
       dex_promise_resolve_object (promise, g_object_ref (entry));
 
-    g_hash_table_remove (task_data->reading_hash, unique_id_checksum);
+    g_hash_table_remove (shard->reading_hash, unique_id_checksum);
   }
   bz_clear_guard (&guard);
 
@@ -678,10 +1339,730 @@ done:
     return dex_future_new_for_object (entry);
 }
 
+typedef struct
+{
+  guint   index;
+  guint64 offset;
+} GetManyMiss;
+
+static int
+cmp_get_many_miss (gconstpointer a,
+                   gconstpointer b)
+{
+  const GetManyMiss *miss_a = a;
+  const GetManyMiss *miss_b = b;
+
+  return miss_a->offset < miss_b->offset ? -1 : miss_a->offset > miss_b->offset;
+}
+
+/* Resolves live entries with one acquisition per shard, then reads
+ * the rest from the store in the order they appear in it
+ */
+static DexFuture *
+get_many_fiber (GetManyTaskData *data)
+{
+  OngoingTaskData *task_data      = data->task_data;
+  GPtrArray       *unique_ids     = data->unique_ids;
+  g_autoptr (GPtrArray) keys      = NULL;
+  g_autoptr (GPtrArray) shards    = NULL;
+  g_autoptr (GArray) offsets      = NULL;
+  g_autoptr (GArray) sizes        = NULL;
+  g_autoptr (GHashTable) resolved = NULL;
+  g_autoptr (GHashTable) queued   = NULL;
+  g_autoptr (GArray) misses       = NULL;
+  g_autoptr (BzGuard) guard       = NULL;
+  g_autoptr (GListStore) store    = NULL;
+
+  dex_await (dex_ref (task_data->init), NULL);
+
+  keys     = g_ptr_array_new_full (unique_ids->len, g_free);
+  shards   = g_ptr_array_sized_new (unique_ids->len);
+  offsets  = g_array_sized_new (FALSE, TRUE, sizeof (guint64), unique_ids->len);
+  sizes    = g_array_sized_new (FALSE, TRUE, sizeof (guint64), unique_ids->len);
+  resolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  queued   = g_hash_table_new (g_str_hash, g_str_equal);
+  misses   = g_array_new (FALSE, FALSE, sizeof (GetManyMiss));
+
+  for (guint i = 0; i < unique_ids->len; i++)
+    {
+      char *key = NULL;
+
+      key = g_compute_checksum_for_string (G_CHECKSUM_MD5, g_ptr_array_index (unique_ids, i), -1);
+      g_ptr_array_add (keys, key);
+      g_ptr_array_add (shards, shard_for_key (task_data, key));
+    }
+  g_array_set_size (offsets, keys->len);
+  g_array_set_size (sizes, keys->len);
+
+  for (guint shard_idx = 0; shard_idx < CACHE_SHARDS; shard_idx++)
+    {
+      CacheShardData *shard = task_data->shards[shard_idx];
+
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                                   &shard->alive_mutex,
+                                   &shard->alive_gate);
+      {
+        for (guint i = 0; i < keys->len; i++)
+          {
+            const char      *key    = NULL;
+            LivingEntryData *living = NULL;
+            BzEntry         *entry  = NULL;
+
+            if (g_ptr_array_index (shards, i) != shard)
+              continue;
+
+            key    = g_ptr_array_index (keys, i);
+            living = g_hash_table_lookup (shard->alive_hash, key);
+            if (living == NULL)
+              continue;
+
+            /* An entry still being read in comes
+             * back NULL and is read like a miss
+             */
+            entry = g_weak_ref_get (&living->wr);
+            if (entry != NULL)
+              g_hash_table_replace (resolved, g_strdup (key), entry);
+          }
+      }
+      bz_clear_guard (&guard);
+    }
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    for (guint i = 0; i < keys->len; i++)
+      {
+        StoreRecordData *record = NULL;
+
+        record = g_hash_table_lookup (task_data->store_index, g_ptr_array_index (keys, i));
+        g_array_index (offsets, guint64, i) = record != NULL ? record->offset : G_MAXUINT64;
+        g_array_index (sizes, guint64, i)   = record != NULL ? record->raw_size : 0;
+      }
+  }
+  bz_clear_guard (&guard);
+
+  for (guint i = 0; i < keys->len; i++)
+    {
+      const char *key   = NULL;
+      BzEntry    *entry = NULL;
+      GetManyMiss miss  = { 0 };
+
+      key   = g_ptr_array_index (keys, i);
+      entry = g_hash_table_lookup (resolved, key);
+      if (entry != NULL)
+        {
+          lru_insert (task_data, key, entry, g_array_index (sizes, guint64, i));
+          continue;
+        }
+      if (!g_hash_table_add (queued, (gpointer) key))
+        continue;
+
+      miss.index  = i;
+      miss.offset = g_array_index (offsets, guint64, i);
+      g_array_append_val (misses, miss);
+    }
+  g_array_sort (misses, cmp_get_many_miss);
+
+  for (guint start = 0; start < misses->len; start += GET_MANY_CONCURRENCY)
+    {
+      g_autoptr (GPtrArray) futures = NULL;
+      guint end                     = 0;
+
+      futures = g_ptr_array_new_with_free_func (dex_unref);
+      end     = MIN (start + GET_MANY_CONCURRENCY, misses->len);
+      for (guint i = start; i < end; i++)
+        {
+          g_autoptr (ReadTaskData) read = NULL;
+
+          read                     = read_task_data_new ();
+          read->task_data          = ongoing_task_data_ref (task_data);
+          read->unique_id_checksum = g_strdup (g_ptr_array_index (
+              keys, g_array_index (misses, GetManyMiss, i).index));
+
+          g_ptr_array_add (
+              futures,
+              dex_scheduler_spawn (
+                  task_data->scheduler,
+                  bz_get_dex_stack_size (),
+                  (DexFiberFunc) read_task_fiber,
+                  read_task_data_ref (read),
+                  read_task_data_unref));
+        }
+
+      dex_await (dex_future_allv (
+                     (DexFuture *const *) futures->pdata, futures->len),
+                 NULL);
+
+      for (guint i = start; i < end; i++)
+        {
+          g_autoptr (GError) local_error = NULL;
+          guint         index            = 0;
+          DexFuture    *future           = NULL;
+          const GValue *value            = NULL;
+
+          index  = g_array_index (misses, GetManyMiss, i).index;
+          future = g_ptr_array_index (futures, i - start);
+          value  = dex_future_get_value (future, &local_error);
+
+          if (value != NULL)
+            g_hash_table_replace (
+                resolved,
+                g_strdup (g_ptr_array_index (keys, index)),
+                g_value_dup_object (value));
+          else
+            g_warning ("%s could not be read from the entry cache: %s",
+                       (const char *) g_ptr_array_index (unique_ids, index),
+                       local_error->message);
+        }
+    }
+
+  store = g_list_store_new (BZ_TYPE_ENTRY);
+  for (guint i = 0; i < keys->len; i++)
+    {
+      BzEntry *entry = NULL;
+
+      entry = g_hash_table_lookup (resolved, g_ptr_array_index (keys, i));
+      if (entry != NULL)
+        g_list_store_append (store, entry);
+    }
+
+  return dex_future_new_for_object (store);
+}
+
+/* Reads hinted entries one at a time until there are no
+ * hints left. Entries read this way are held by the LRU,
+ * so they are still alive when they are asked for
+ */
+static DexFuture *
+prefetch_fiber (OngoingTaskData *task_data)
+{
+  dex_await (dex_ref (task_data->init), NULL);
+
+  for (;;)
+    {
+      g_autoptr (GMutexLocker) locker = NULL;
+      g_autofree char *key            = NULL;
+      g_autoptr (ReadTaskData) read   = NULL;
+
+      dex_await (dex_timeout_new_msec (PREFETCH_DELAY_MSEC), NULL);
+
+      locker = g_mutex_locker_new (&task_data->prefetch_mutex);
+      key    = g_queue_pop_head (&task_data->prefetch_queue);
+      if (key == NULL)
+        {
+          task_data->prefetch_running = FALSE;
+          return dex_future_new_true ();
+        }
+      g_hash_table_remove (task_data->prefetch_hash, key);
+      g_clear_pointer (&locker, g_mutex_locker_free);
+
+      read                     = read_task_data_new ();
+      read->task_data          = ongoing_task_data_ref (task_data);
+      read->unique_id_checksum = g_steal_pointer (&key);
+
+      /* The read is awaited rather than run in its
+       * own fiber, so prefetches never pile up
+       */
+      dex_await (read_task_fiber (read), NULL);
+    }
+}
+
+static CacheShardData *
+shard_for_key (OngoingTaskData *task_data,
+               const char      *key)
+{
+  return task_data->shards[g_str_hash (key) % CACHE_SHARDS];
+}
+
+/* Serializes `entry` and returns the digest of the
+ * result along with the validator to store it under
+ */
+static GBytes *
+serialize_entry (BzEntry     *entry,
+                 const char **validator,
+                 guint8      *digest)
+{
+  g_autoptr (GVariant) variant   = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GChecksum) checksum = NULL;
+  gsize digest_len               = 16;
+
+  variant = g_variant_ref_sink (bz_serializable_serialize_compact (BZ_SERIALIZABLE (entry)));
+  bytes   = g_variant_get_data_as_bytes (variant);
+
+  *validator = bz_flatpak_entry_get_cache_validator (BZ_FLATPAK_ENTRY (entry));
+  if (*validator == NULL)
+    *validator = "";
+
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  g_checksum_update (
+      checksum,
+      g_bytes_get_data (bytes, NULL),
+      g_bytes_get_size (bytes));
+  g_checksum_get_digest (checksum, digest, &digest_len);
+
+  return g_steal_pointer (&bytes);
+}
+
+static DexFuture *
+ingest_worker_fiber (OngoingTaskData *task_data)
+{
+  dex_await (dex_ref (task_data->init), NULL);
+
+  for (;;)
+    {
+      g_autoptr (GError) local_error = NULL;
+      g_autoptr (IngestItem) item    = NULL;
+      gboolean result                = FALSE;
+
+      /* Only fails once the channel is closed */
+      item = dex_await_boxed (dex_channel_receive (task_data->ingest_channel), NULL);
+      if (item == NULL)
+        break;
+
+      result = ingest_entry (task_data, item->entry, &local_error);
+      if (!result)
+        g_debug ("Failed to ingest entry %s: %s",
+                 bz_entry_get_unique_id_checksum (item->entry),
+                 local_error->message);
+
+      ingest_finish (task_data, item->ticket, result);
+    }
+
+  return dex_future_new_true ();
+}
+
+/* Marks `ticket` as finished and wakes up the flushes
+ * waiting on every ticket up to theirs. Tickets finish
+ * out of order, so those past the first unfinished one
+ * are set aside until it catches up
+ */
+static void
+ingest_finish (OngoingTaskData *task_data,
+               guint            ticket,
+               gboolean         succeeded)
+{
+  g_autoptr (GPtrArray) ready     = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  ready = g_ptr_array_new_with_free_func (ingest_waiter_data_unref);
+
+  locker = g_mutex_locker_new (&task_data->ingest_ticket_mutex);
+  if (!succeeded)
+    task_data->ingest_failed++;
+
+  if (ticket == task_data->ingest_done + 1)
+    {
+      task_data->ingest_done = ticket;
+      while (g_hash_table_remove (
+          task_data->ingest_finished,
+          GUINT_TO_POINTER (task_data->ingest_done + 1)))
+        task_data->ingest_done++;
+    }
+  else
+    g_hash_table_add (task_data->ingest_finished, GUINT_TO_POINTER (ticket));
+
+  for (guint i = 0; i < task_data->ingest_waiters->len;)
+    {
+      IngestWaiterData *waiter = NULL;
+
+      waiter = g_ptr_array_index (task_data->ingest_waiters, i);
+      if (waiter->target <= task_data->ingest_done)
+        g_ptr_array_add (ready, g_ptr_array_steal_index_fast (task_data->ingest_waiters, i));
+      else
+        i++;
+    }
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  for (guint i = 0; i < ready->len; i++)
+    {
+      IngestWaiterData *waiter = NULL;
+
+      waiter = g_ptr_array_index (ready, i);
+      dex_promise_resolve_boolean (waiter->promise, TRUE);
+    }
+}
+
+/* The channel refused the entry, so it is never going
+ * to be finished by a worker and a flush must not wait
+ */
+static DexFuture *
+ingest_send_rejected_cb (DexFuture      *future,
+                         IngestSendData *data)
+{
+  ingest_finish (data->task_data, data->ticket, FALSE);
+  return dex_ref (future);
+}
+
+static IngestItem *
+ingest_item_copy (IngestItem *item)
+{
+  IngestItem *copy = NULL;
+
+  copy         = g_new0 (IngestItem, 1);
+  copy->entry  = g_object_ref (item->entry);
+  copy->ticket = item->ticket;
+
+  return copy;
+}
+
+static void
+ingest_item_free (IngestItem *item)
+{
+  g_clear_object (&item->entry);
+  g_free (item);
+}
+
+static gboolean
+ingest_entry (OngoingTaskData *task_data,
+              BzEntry         *entry,
+              GError         **error)
+{
+  const char *unique_id_checksum   = NULL;
+  g_autoptr (GBytes) bytes         = NULL;
+  g_autoptr (GBytes) payload       = NULL;
+  const char *validator            = NULL;
+  guint8      digest[16]           = { 0 };
+  guint16     codec                = STORE_CODEC_NONE;
+  g_autoptr (BzGuard) guard        = NULL;
+  g_autoptr (GPtrArray) superseded = NULL;
+  gboolean    result               = FALSE;
+
+  unique_id_checksum = bz_entry_get_unique_id_checksum (entry);
+  if (!BZ_IS_FLATPAK_ENTRY (entry))
+    {
+      g_set_error (error, BZ_ENTRY_CACHE_ERROR, BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
+                   "Entry with unique ID checksum '%s' cannot be "
+                   "cached because it is not a flatpak entry",
+                   unique_id_checksum);
+      return FALSE;
+    }
+
+  /* Serializing and compressing are the expensive
+   * parts and happen without holding anything
+   */
+  bytes = serialize_entry (entry, &validator, digest);
+  if (store_is_current (task_data, unique_id_checksum, validator, digest))
+    return TRUE;
+  payload    = store_encode_payload (task_data, bytes, &codec);
+  superseded = g_ptr_array_new_with_free_func (g_free);
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->ingest_mutex,
+                               &task_data->ingest_gate);
+  {
+    result = store_batch_encode (
+        task_data->ingest_batch,
+        unique_id_checksum,
+        validator,
+        digest,
+        codec,
+        g_bytes_get_size (bytes),
+        payload,
+        error);
+    if (result &&
+        task_data->ingest_batch->buffer->len >= INGEST_BATCH_BYTES)
+      result = store_append_batch (task_data, task_data->ingest_batch, superseded, error);
+  }
+  bz_clear_guard (&guard);
+
+  forget_superseded (task_data, superseded);
+
+  return result;
+}
+
+/* Waits for every entry queued so far, appends what is
+ * left of the batch and syncs the store once
+ */
+static DexFuture *
+ingest_flush_fiber (OngoingTaskData *task_data)
+{
+  g_autoptr (GError) local_error   = NULL;
+  g_autoptr (GMutexLocker) locker  = NULL;
+  g_autoptr (BzGuard) guard        = NULL;
+  g_autoptr (DexPromise) promise   = NULL;
+  g_autoptr (GPtrArray) superseded = NULL;
+  guint    queued                  = 0;
+  guint    failed                  = 0;
+  gboolean refreshed               = FALSE;
+  gboolean result                  = FALSE;
+
+  queued = g_atomic_int_get (&task_data->ingest_queued);
+
+  locker = g_mutex_locker_new (&task_data->ingest_ticket_mutex);
+  if (task_data->ingest_done < queued)
+    {
+      g_autoptr (IngestWaiterData) waiter = NULL;
+
+      promise         = dex_promise_new ();
+      waiter          = ingest_waiter_data_new ();
+      waiter->target  = queued;
+      waiter->promise = dex_ref (promise);
+      g_ptr_array_add (task_data->ingest_waiters, g_steal_pointer (&waiter));
+    }
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  if (promise != NULL)
+    dex_await (dex_ref (promise), NULL);
+
+  superseded = g_ptr_array_new_with_free_func (g_free);
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->ingest_mutex,
+                               &task_data->ingest_gate);
+  {
+    result = store_append_batch (task_data, task_data->ingest_batch, superseded, &local_error);
+  }
+  bz_clear_guard (&guard);
+
+  locker                    = g_mutex_locker_new (&task_data->ingest_ticket_mutex);
+  failed                    = task_data->ingest_failed;
+  task_data->ingest_failed  = 0;
+  refreshed                 = task_data->ingest_done > task_data->ingest_flushed;
+  task_data->ingest_flushed = task_data->ingest_done;
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  /* A refresh hands us every entry there is, so those
+   * it did not bring up again are gone from the remotes
+   */
+  if (result && refreshed)
+    store_prune (task_data, superseded);
+  forget_superseded (task_data, superseded);
+
+  if (!result)
+    return dex_future_new_reject (
+        BZ_ENTRY_CACHE_ERROR,
+        BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
+        "Failed to flush queued entries to the store: %s",
+        local_error->message);
+
+  store_sync (task_data);
+  if (failed > 0)
+    g_debug ("%d queued entries could not be cached", failed);
+
+  return dex_future_new_true ();
+}
+
+/* Drops the least recently used entries until the
+ * rest fit the budget. The LRU mutex must be held
+ */
+static void
+lru_evict_locked (OngoingTaskData *task_data,
+                  GPtrArray       *evicted)
+{
+  while ((task_data->lru_usage > task_data->lru_budget ||
+          task_data->lru_queue.length > LRU_MAX_ENTRIES) &&
+         task_data->lru_queue.length > 0)
+    {
+      LruEntryData *node = NULL;
+
+      node = g_queue_pop_tail (&task_data->lru_queue);
+      g_hash_table_remove (task_data->lru_hash, node->key);
+      task_data->lru_usage -= node->size;
+      g_ptr_array_add (evicted, node);
+    }
+}
+
+static BzEntry *
+lru_lookup (OngoingTaskData *task_data,
+            const char      *key)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  GList *link                     = NULL;
+
+  locker = g_mutex_locker_new (&task_data->lru_mutex);
+  link   = g_hash_table_lookup (task_data->lru_hash, key);
+  if (link == NULL)
+    return NULL;
+
+  g_queue_unlink (&task_data->lru_queue, link);
+  g_queue_push_head_link (&task_data->lru_queue, link);
+
+  return g_object_ref (((LruEntryData *) link->data)->entry);
+}
+
+/* Estimates how much memory `entry` takes up, given the
+ * size of its serialized form. Its icon only counts once
+ * it has been loaded, so this is redone every time the
+ * entry is used again
+ */
+static guint64
+lru_estimate_size (BzEntry *entry,
+                   guint64  raw_size)
+{
+  GdkPaintable *icon = NULL;
+  guint64       size = 0;
+
+  size = raw_size * LRU_EXPANSION + LRU_ENTRY_OVERHEAD;
+
+  icon = bz_entry_get_icon_paintable (entry);
+  if (icon != NULL && GDK_IS_TEXTURE (icon))
+    size += (guint64) gdk_texture_get_width (GDK_TEXTURE (icon)) *
+            (guint64) gdk_texture_get_height (GDK_TEXTURE (icon)) * 4;
+
+  return size;
+}
+
+/* Marks `entry` as the most recently used. A `raw_size` of
+ * zero has the store asked for the size of its record
+ */
+static void
+lru_insert (OngoingTaskData *task_data,
+            const char      *key,
+            BzEntry         *entry,
+            guint64          raw_size)
+{
+  g_autoptr (GPtrArray) evicted   = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  GList        *link              = NULL;
+  LruEntryData *node              = NULL;
+  guint64       size              = 0;
+
+  if (raw_size == 0)
+    {
+      g_autoptr (BzGuard) guard = NULL;
+
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                                   &task_data->store_mutex,
+                                   &task_data->store_gate);
+      {
+        StoreRecordData *record = NULL;
+
+        record = g_hash_table_lookup (task_data->store_index, key);
+        if (record != NULL)
+          raw_size = record->raw_size;
+      }
+      bz_clear_guard (&guard);
+    }
+  size = lru_estimate_size (entry, raw_size);
+
+  /* Released outside the lock, since the last
+   * reference to an entry may go with them
+   */
+  evicted = g_ptr_array_new_with_free_func (lru_entry_data_unref);
+
+  locker = g_mutex_locker_new (&task_data->lru_mutex);
+  link   = g_hash_table_lookup (task_data->lru_hash, key);
+  if (link != NULL)
+    {
+      node = link->data;
+      g_queue_unlink (&task_data->lru_queue, link);
+      g_queue_push_head_link (&task_data->lru_queue, link);
+
+      if (node->entry != entry)
+        g_set_object (&node->entry, entry);
+      task_data->lru_usage -= node->size;
+      node->size = size;
+      task_data->lru_usage += node->size;
+    }
+  else
+    {
+      node        = lru_entry_data_new ();
+      node->key   = g_strdup (key);
+      node->entry = g_object_ref (entry);
+      node->size  = size;
+
+      g_queue_push_head (&task_data->lru_queue, node);
+      g_hash_table_replace (task_data->lru_hash, node->key, task_data->lru_queue.head);
+      task_data->lru_usage += node->size;
+    }
+
+  lru_evict_locked (task_data, evicted);
+  g_clear_pointer (&locker, g_mutex_locker_free);
+}
+
+static void
+lru_set_budget (OngoingTaskData *task_data,
+                guint64          budget)
+{
+  g_autoptr (GPtrArray) evicted   = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  evicted = g_ptr_array_new_with_free_func (lru_entry_data_unref);
+
+  locker                = g_mutex_locker_new (&task_data->lru_mutex);
+  task_data->lru_budget = budget;
+  lru_evict_locked (task_data, evicted);
+  g_clear_pointer (&locker, g_mutex_locker_free);
+}
+
+static void
+lru_remove (OngoingTaskData *task_data,
+            const char      *key)
+{
+  g_autoptr (LruEntryData) node   = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  GList *link                     = NULL;
+
+  locker = g_mutex_locker_new (&task_data->lru_mutex);
+  link   = g_hash_table_lookup (task_data->lru_hash, key);
+  if (link == NULL)
+    return;
+
+  node = link->data;
+  g_hash_table_remove (task_data->lru_hash, key);
+  g_queue_delete_link (&task_data->lru_queue, link);
+  task_data->lru_usage -= node->size;
+  g_clear_pointer (&locker, g_mutex_locker_free);
+}
+
+/* Stops handing out the entries a newer record was written
+ * for, or whose record was pruned, so the next lookup goes
+ * to the store. Whoever holds the old entries keeps them,
+ * but they are no longer written back over the new record
+ */
+static void
+forget_superseded (OngoingTaskData *task_data,
+                   GPtrArray       *keys)
+{
+  for (guint i = 0; i < keys->len; i++)
+    {
+      const char     *key                = NULL;
+      CacheShardData *shard              = NULL;
+      g_autoptr (BzGuard) guard          = NULL;
+      g_autofree char *alive_key         = NULL;
+      g_autoptr (LivingEntryData) living = NULL;
+
+      key   = g_ptr_array_index (keys, i);
+      shard = shard_for_key (task_data, key);
+
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                                   &shard->alive_mutex,
+                                   &shard->alive_gate);
+      {
+        g_hash_table_steal_extended (
+            shard->alive_hash, key,
+            (gpointer *) &alive_key,
+            (gpointer *) &living);
+      }
+      bz_clear_guard (&guard);
+
+      /* A read of the old record may still be in flight, and
+       * it holds the living entry until it is in the LRU
+       */
+      if (living != NULL)
+        {
+          BZ_BEGIN_GUARD_WITH_CONTEXT (&guard, &living->mutex, &living->gate);
+          bz_clear_guard (&guard);
+        }
+
+      lru_remove (task_data, key);
+    }
+}
+
 static DexFuture *
 watch_init_fiber (OngoingTaskData *task_data)
 {
-  bz_discard_module_dir ();
+  g_autoptr (GError) local_error = NULL;
+  gboolean result                = FALSE;
+
+  /* Records survive across sessions unless they
+   * were written by a different version of us
+   */
+  result = store_open (task_data, &local_error);
+  if (!result)
+    g_warning ("Entry cache is unavailable: %s", local_error->message);
   dex_promise_resolve_boolean (task_data->init, TRUE);
 
   return dex_future_finally_loop (
@@ -706,81 +2087,102 @@ watch_cb (DexFuture       *future,
 static DexFuture *
 watch_work_fiber (OngoingTaskData *task_data)
 {
-  g_autoptr (BzGuard) guard0        = NULL;
-  GHashTableIter iter               = { 0 };
   g_autoptr (GTimer) timer          = NULL;
   g_autoptr (GPtrArray) write_backs = NULL;
-  guint total                       = 0;
-  guint skipped                     = 0;
-  guint written                     = 0;
-  guint pruned                      = 0;
+  guint   total                     = 0;
+  guint   skipped                   = 0;
+  guint   clean                     = 0;
+  guint   written                   = 0;
+  guint   pruned                    = 0;
+  guint64 written_bytes             = 0;
+  guint64 changed_bytes             = 0;
 
   timer       = g_timer_new ();
   write_backs = g_ptr_array_new_with_free_func (dex_unref);
 
-  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &task_data->alive_mutex, &task_data->alive_gate);
-  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &task_data->reading_mutex, &task_data->reading_gate);
-  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &task_data->writing_mutex, &task_data->writing_gate);
-
-  g_hash_table_iter_init (&iter, task_data->alive_hash);
-  for (;;)
+  /* Only one shard is held at a time, so
+   * lookups elsewhere carry on meanwhile
+   */
+  for (guint i = 0; i < G_N_ELEMENTS (task_data->shards); i++)
     {
-      char            *unique_id_checksum = NULL;
-      LivingEntryData *living             = NULL;
-      g_autoptr (BzGuard) guard1          = NULL;
-      g_autoptr (BzEntry) entry           = NULL;
+      CacheShardData *shard      = task_data->shards[i];
+      g_autoptr (BzGuard) guard0 = NULL;
+      GHashTableIter iter        = { 0 };
 
-      if (!g_hash_table_iter_next (&iter, (gpointer *) &unique_id_checksum, (gpointer *) &living))
-        break;
-      total++;
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &shard->alive_mutex, &shard->alive_gate);
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &shard->reading_mutex, &shard->reading_gate);
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard0, &shard->writing_mutex, &shard->writing_gate);
 
-      if (g_hash_table_contains (task_data->reading_hash, unique_id_checksum) ||
-          g_hash_table_contains (task_data->writing_hash, unique_id_checksum))
+      g_hash_table_iter_init (&iter, shard->alive_hash);
+      for (;;)
         {
-          skipped++;
-          continue;
-        }
+          char            *unique_id_checksum = NULL;
+          LivingEntryData *living             = NULL;
+          g_autoptr (BzGuard) guard1          = NULL;
+          g_autoptr (BzEntry) entry           = NULL;
 
-      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard1, &living->mutex, &living->gate);
+          if (!g_hash_table_iter_next (&iter, (gpointer *) &unique_id_checksum, (gpointer *) &living))
+            break;
+          total++;
 
-      entry = g_weak_ref_get (&living->wr);
-      if (entry != NULL)
-        {
-          if (bz_entry_is_of_kinds (entry, BZ_ENTRY_KIND_APPLICATION) &&
-              g_timer_elapsed (living->cached, NULL) > WATCH_RECACHE_INTERVAL_SEC_DOUBLE)
+          if (g_hash_table_contains (shard->reading_hash, unique_id_checksum) ||
+              g_hash_table_contains (shard->writing_hash, unique_id_checksum))
             {
-              g_autoptr (WriteTaskData) data = NULL;
-              g_autoptr (DexFuture) future   = NULL;
+              skipped++;
+              continue;
+            }
 
-              data                     = write_task_data_new ();
-              data->task_data          = ongoing_task_data_ref (task_data);
-              data->unique_id_checksum = g_strdup (unique_id_checksum);
-              data->entry              = g_object_ref (entry);
+          BZ_BEGIN_GUARD_WITH_CONTEXT (&guard1, &living->mutex, &living->gate);
 
-              future = dex_scheduler_spawn (
-                  task_data->scheduler,
-                  bz_get_dex_stack_size (),
-                  (DexFiberFunc) write_task_fiber,
-                  write_task_data_ref (data),
-                  write_task_data_unref);
-              g_ptr_array_add (write_backs, g_steal_pointer (&future));
-              written++;
+          entry = g_weak_ref_get (&living->wr);
+          if (entry != NULL)
+            {
+              if (!bz_entry_is_of_kinds (entry, BZ_ENTRY_KIND_APPLICATION) ||
+                  g_timer_elapsed (living->cached, NULL) <= WATCH_RECACHE_INTERVAL_SEC_DOUBLE)
+                continue;
+
+              if (living->persisted &&
+                  living->generation == bz_entry_get_generation (entry))
+                clean++;
+              else
+                {
+                  g_autoptr (WriteTaskData) data = NULL;
+                  g_autoptr (DexFuture) future   = NULL;
+
+                  data                     = write_task_data_new ();
+                  data->task_data          = ongoing_task_data_ref (task_data);
+                  data->unique_id_checksum = g_strdup (unique_id_checksum);
+                  data->entry              = g_object_ref (entry);
+
+                  future = dex_scheduler_spawn (
+                      task_data->scheduler,
+                      bz_get_dex_stack_size (),
+                      (DexFiberFunc) write_task_fiber,
+                      write_task_data_ref (data),
+                      write_task_data_unref);
+                  g_ptr_array_add (write_backs, g_steal_pointer (&future));
+                  written++;
+                }
+            }
+          else
+            {
+              bz_clear_guard (&guard1);
+              g_hash_table_iter_remove (&iter);
+              pruned++;
             }
         }
-      else
-        {
-          bz_clear_guard (&guard1);
-          g_hash_table_iter_remove (&iter);
-          pruned++;
-        }
+
+      bz_clear_guard (&guard0);
     }
 
-  bz_clear_guard (&guard0);
+  store_take_write_stats (task_data, NULL, NULL);
   if (write_backs->len > 0)
     dex_await (dex_future_allv (
                    (DexFuture *const *) write_backs->pdata,
                    write_backs->len),
                NULL);
+  store_maintain (task_data);
+  store_take_write_stats (task_data, &written_bytes, &changed_bytes);
 
 #ifdef __GLIBC__
   malloc_trim (0);
@@ -789,13 +2191,1297 @@ watch_work_fiber (OngoingTaskData *task_data)
   g_debug ("Sweep report: finished in %.4f seconds, including time to acquire guards\n"
            "  Out of a total of %d entries considered:\n"
            "    %d were skipped due to active tasks being associated with them\n"
-           "    %d application entries were kept alive but written to back to disk\n"
+           "    %d application entries were kept alive but unchanged since they were stored\n"
+           "    %d application entries were kept alive and written back to disk\n"
            "    %d entries were forgotten by the application and were pruned\n"
+           "  %" G_GUINT64_FORMAT " bytes hit the disk for %" G_GUINT64_FORMAT
+           " bytes of changed entries, a write amplification of %.2f\n"
            "  Another sweep will take place in %d msec",
            g_timer_elapsed (timer, NULL),
-           total, skipped, written, pruned, WATCH_CLEANUP_INTERVAL_MSEC);
+           total, skipped, clean, written, pruned,
+           written_bytes, changed_bytes,
+           changed_bytes > 0 ? (double) written_bytes / (double) changed_bytes : 0.0,
+           WATCH_CLEANUP_INTERVAL_MSEC);
 
   return dex_timeout_new_msec (WATCH_CLEANUP_INTERVAL_MSEC);
 }
 
+static gboolean
+store_pread (int     fd,
+             void   *buffer,
+             gsize   length,
+             guint64 offset)
+{
+  gsize done = 0;
+
+  while (done < length)
+    {
+      gssize bytes_read = 0;
+
+      bytes_read = pread (fd, (guint8 *) buffer + done, length - done, offset + done);
+      if (bytes_read < 0 && errno == EINTR)
+        continue;
+      if (bytes_read <= 0)
+        return FALSE;
+      done += bytes_read;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+store_pwrite (int         fd,
+              const void *buffer,
+              gsize       length,
+              guint64     offset)
+{
+  gsize done = 0;
+
+  while (done < length)
+    {
+      gssize bytes_written = 0;
+
+      bytes_written = pwrite (fd, (const guint8 *) buffer + done, length - done, offset + done);
+      if (bytes_written < 0 && errno == EINTR)
+        continue;
+      if (bytes_written < 0)
+        return FALSE;
+      done += bytes_written;
+    }
+
+  return TRUE;
+}
+
+static StoreSegmentData *
+store_create_segment (const char *path,
+                      GError    **error)
+{
+  g_autoptr (StoreSegmentData) segment = NULL;
+  StoreFileHeader file_header          = { 0 };
+  gboolean        result               = FALSE;
+
+  segment       = store_segment_data_new ();
+  segment->fd   = open (path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  segment->path = g_strdup (path);
+  if (segment->fd < 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to create store at %s: %s",
+                   path, g_strerror (errsv));
+      return NULL;
+    }
+
+  memcpy (file_header.magic, STORE_MAGIC, sizeof (STORE_MAGIC));
+  file_header.version = CACHE_FORMAT_VERSION;
+
+  result = store_pwrite (segment->fd, &file_header, sizeof (file_header), 0);
+  if (!result)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to write store header to %s: %s",
+                   path, g_strerror (errsv));
+      return NULL;
+    }
+  segment->size = sizeof (file_header);
+
+  return g_steal_pointer (&segment);
+}
+
+/* Opens the store left behind by a previous session and
+ * indexes the latest record of every key in it
+ */
+static gboolean
+store_open (OngoingTaskData *task_data,
+            GError         **error)
+{
+  g_autofree char *main_cache          = NULL;
+  g_autofree char *path                = NULL;
+  g_autofree char *dict_path           = NULL;
+  g_autoptr (StoreSegmentData) segment = NULL;
+  StoreFileHeader file_header          = { 0 };
+  struct stat     stat_buf             = { 0 };
+  guint64         offset               = 0;
+  guint           n_records            = 0;
+  guint           n_unreadable         = 0;
+
+  main_cache = bz_dup_module_dir ();
+  path       = g_build_filename (main_cache, STORE_FILENAME, NULL);
+  if (g_mkdir_with_parents (main_cache, 0755) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to make cache directory %s: %s",
+                   main_cache, g_strerror (errsv));
+      return FALSE;
+    }
+
+  segment       = store_segment_data_new ();
+  segment->fd   = open (path, O_RDWR | O_CLOEXEC);
+  segment->path = g_strdup (path);
+
+  if (segment->fd < 0 ||
+      fstat (segment->fd, &stat_buf) != 0 ||
+      !store_pread (segment->fd, &file_header, sizeof (file_header), 0) ||
+      memcmp (file_header.magic, STORE_MAGIC, sizeof (STORE_MAGIC)) != 0 ||
+      file_header.version != CACHE_FORMAT_VERSION)
+    {
+      /* Either there is no cache yet, or it was written
+       * by a different version of us, possibly still as
+       * one file per entry
+       */
+      g_clear_pointer (&segment, store_segment_data_unref);
+      bz_discard_module_dir ();
+      g_mkdir_with_parents (main_cache, 0755);
+
+      segment = store_create_segment (path, error);
+      if (segment == NULL)
+        return FALSE;
+
+      task_data->segment = g_steal_pointer (&segment);
+      return TRUE;
+    }
+
+  dict_path             = g_build_filename (main_cache, DICT_FILENAME, NULL);
+  task_data->store_dict = store_dict_load (dict_path);
+
+  offset = sizeof (file_header);
+  for (;;)
+    {
+      StoreRecordHeader header           = { 0 };
+      guint64           payload_offset   = 0;
+      guint64           length           = 0;
+      g_autofree char  *key              = NULL;
+      g_autoptr (StoreRecordData) record = NULL;
+      StoreRecordData *old               = NULL;
+
+      if (!store_pread (segment->fd, &header, sizeof (header), offset) ||
+          header.magic != RECORD_MAGIC)
+        break;
+
+      payload_offset = STORE_ALIGN (sizeof (header) + header.validator_size);
+      length         = payload_offset + STORE_ALIGN (header.payload_size);
+      if (offset + length > (guint64) stat_buf.st_size)
+        break;
+
+      /* Compressed without a dictionary we can load, either
+       * because it went missing or we were built without
+       * zstd. The record is left to be compacted away
+       */
+      if (header.codec != STORE_CODEC_NONE &&
+          (header.codec != STORE_CODEC_ZSTD_DICT || task_data->store_dict == NULL))
+        {
+          offset += length;
+          n_records++;
+          n_unreadable++;
+          continue;
+        }
+
+      record                 = store_record_data_new ();
+      record->offset         = offset;
+      record->length         = length;
+      record->payload_offset = payload_offset;
+      record->payload_size   = header.payload_size;
+      record->raw_size       = header.raw_size;
+      record->codec          = header.codec;
+      record->validator      = g_malloc0 (header.validator_size + 1);
+      memcpy (record->digest, header.digest, sizeof (record->digest));
+
+      if (!store_pread (segment->fd, record->validator, header.validator_size, offset + sizeof (header)))
+        break;
+
+      key = g_strndup (header.key, sizeof (header.key));
+      old = g_hash_table_lookup (task_data->store_index, key);
+      if (old != NULL)
+        task_data->store_live_bytes -= old->length;
+      task_data->store_live_bytes += length;
+      g_hash_table_replace (
+          task_data->store_index,
+          g_steal_pointer (&key),
+          g_steal_pointer (&record));
+
+      offset += length;
+      n_records++;
+    }
+
+  /* Anything past the last complete record
+   * is left over from an interrupted write
+   */
+  if (offset < (guint64) stat_buf.st_size &&
+      ftruncate (segment->fd, offset) != 0)
+    g_warning ("Failed to truncate incomplete records from %s: %s",
+               path, g_strerror (errno));
+  segment->size = offset;
+
+  g_debug ("Resuming with %d entries cached by a previous session, "
+           "%d records of which %d are unreadable and %" G_GUINT64_FORMAT
+           " bytes in total, %s a compression dictionary",
+           g_hash_table_size (task_data->store_index), n_records, n_unreadable, offset,
+           task_data->store_dict != NULL ? "with" : "without");
+
+  task_data->segment = g_steal_pointer (&segment);
+  return TRUE;
+}
+
+static gboolean
+store_is_current (OngoingTaskData *task_data,
+                  const char      *key,
+                  const char      *validator,
+                  const guint8    *digest)
+{
+  g_autoptr (BzGuard) guard = NULL;
+  StoreRecordData *record   = NULL;
+  gboolean         current  = FALSE;
+  gboolean         stale    = FALSE;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    record  = g_hash_table_lookup (task_data->store_index, key);
+    current = record != NULL &&
+              memcmp (record->digest, digest, sizeof (record->digest)) == 0 &&
+              g_strcmp0 (record->validator, validator) == 0;
+
+    /* Made for a different ref or appstream commit, so it is
+     * not read again even before its replacement is appended
+     */
+    stale = record != NULL &&
+            g_strcmp0 (record->validator, validator) != 0;
+    if (stale)
+      record->stale = TRUE;
+    if (current)
+      record->epoch = task_data->store_epoch;
+  }
+  bz_clear_guard (&guard);
+
+  if (stale)
+    lru_remove (task_data, key);
+
+  return current;
+}
+
+static gboolean
+store_append (OngoingTaskData *task_data,
+              const char      *key,
+              const char      *validator,
+              const guint8    *digest,
+              GBytes          *bytes,
+              GError         **error)
+{
+  g_autoptr (StoreBatchData) batch = NULL;
+  g_autoptr (GBytes) payload       = NULL;
+  guint16  codec                   = STORE_CODEC_NONE;
+  gboolean result                  = FALSE;
+
+  payload = store_encode_payload (task_data, bytes, &codec);
+  batch   = store_batch_new ();
+  result  = store_batch_encode (
+      batch, key, validator, digest,
+      codec, g_bytes_get_size (bytes), payload,
+      error);
+  if (!result)
+    return FALSE;
+
+  return store_append_batch (task_data, batch, NULL, error);
+}
+
+static StoreBatchData *
+store_batch_new (void)
+{
+  g_autoptr (StoreBatchData) batch = NULL;
+
+  batch            = store_batch_data_new ();
+  batch->buffer    = g_byte_array_new ();
+  batch->keys      = g_ptr_array_new_with_free_func (g_free);
+  batch->records   = g_ptr_array_new_with_free_func (store_record_data_unref);
+  batch->positions = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return g_steal_pointer (&batch);
+}
+
+static void
+store_batch_clear (StoreBatchData *batch)
+{
+  g_hash_table_remove_all (batch->positions);
+  g_byte_array_set_size (batch->buffer, 0);
+  g_ptr_array_set_size (batch->keys, 0);
+  g_ptr_array_set_size (batch->records, 0);
+}
+
+/* Encodes a record onto the end of `batch`, its offset
+ * is relative to the batch until it is appended.
+ * `payload` is `raw_size` bytes once decoded by `codec`
+ */
+static gboolean
+store_batch_encode (StoreBatchData *batch,
+                    const char     *key,
+                    const char     *validator,
+                    const guint8   *digest,
+                    guint16         codec,
+                    gsize           raw_size,
+                    GBytes         *payload,
+                    GError        **error)
+{
+  gsize              payload_size    = 0;
+  gsize              validator_size  = 0;
+  guint64            payload_offset  = 0;
+  guint64            length          = 0;
+  guint8            *buffer          = NULL;
+  StoreRecordHeader *header          = NULL;
+  g_autoptr (StoreRecordData) record = NULL;
+
+  payload_size   = g_bytes_get_size (payload);
+  validator_size = strlen (validator);
+  if (strlen (key) != sizeof (header->key) ||
+      payload_size > G_MAXUINT32 ||
+      raw_size > G_MAXUINT32 ||
+      validator_size > G_MAXUINT16)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Record for %s cannot be stored", key);
+      return FALSE;
+    }
+  payload_offset = STORE_ALIGN (sizeof (*header) + validator_size);
+  length         = payload_offset + STORE_ALIGN (payload_size);
+
+  record                 = store_record_data_new ();
+  record->offset         = batch->buffer->len;
+  record->length         = length;
+  record->payload_offset = payload_offset;
+  record->payload_size   = payload_size;
+  record->raw_size       = raw_size;
+  record->codec          = codec;
+  record->validator      = g_strdup (validator);
+  record->verified       = TRUE;
+  memcpy (record->digest, digest, sizeof (record->digest));
+
+  g_byte_array_set_size (batch->buffer, batch->buffer->len + length);
+  buffer = batch->buffer->data + record->offset;
+  memset (buffer, 0, length);
+
+  header                 = (StoreRecordHeader *) buffer;
+  header->magic          = RECORD_MAGIC;
+  header->payload_size   = payload_size;
+  header->validator_size = validator_size;
+  header->codec          = codec;
+  header->raw_size       = raw_size;
+  memcpy (header->key, key, sizeof (header->key));
+  memcpy (header->digest, digest, sizeof (header->digest));
+  memcpy (buffer + sizeof (*header), validator, validator_size);
+  memcpy (buffer + payload_offset, g_bytes_get_data (payload, NULL), payload_size);
+
+  g_ptr_array_add (batch->keys, g_strdup (key));
+  g_ptr_array_add (batch->records, g_steal_pointer (&record));
+  g_hash_table_replace (
+      batch->positions,
+      g_ptr_array_index (batch->keys, batch->keys->len - 1),
+      GUINT_TO_POINTER (batch->keys->len));
+
+  return TRUE;
+}
+
+/* Appends every record of `batch` with a single
+ * write and leaves the batch empty either way. The
+ * keys of records which replaced an older one are
+ * added to `superseded`, if given
+ */
+static gboolean
+store_append_batch (OngoingTaskData *task_data,
+                    StoreBatchData  *batch,
+                    GPtrArray       *superseded,
+                    GError         **error)
+{
+  g_autoptr (BzGuard) guard = NULL;
+  gboolean result           = FALSE;
+
+  if (batch->records->len == 0)
+    return TRUE;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    StoreSegmentData *segment = task_data->segment;
+    guint64           base    = 0;
+
+    if (segment == NULL)
+      {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED,
+                     "The store could not be opened");
+        goto done;
+      }
+
+    base   = segment->size;
+    result = store_pwrite (segment->fd, batch->buffer->data, batch->buffer->len, base);
+    if (!result)
+      {
+        int errsv = errno;
+
+        /* Leave no partial record behind */
+        if (ftruncate (segment->fd, base) != 0)
+          g_warning ("Failed to truncate %s: %s", segment->path, g_strerror (errno));
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Failed to append to %s: %s",
+                     segment->path, g_strerror (errsv));
+        goto done;
+      }
+    segment->size += batch->buffer->len;
+    task_data->store_written_bytes += batch->buffer->len;
+    task_data->store_unsynced = TRUE;
+
+    for (guint i = 0; i < batch->records->len; i++)
+      {
+        const char      *key    = NULL;
+        StoreRecordData *record = NULL;
+        StoreRecordData *old    = NULL;
+
+        key    = g_ptr_array_index (batch->keys, i);
+        record = g_ptr_array_index (batch->records, i);
+        record->offset += base;
+        record->epoch = task_data->store_epoch;
+
+        old = g_hash_table_lookup (task_data->store_index, key);
+        if (old != NULL)
+          {
+            task_data->store_live_bytes -= old->length;
+            if (superseded != NULL)
+              g_ptr_array_add (superseded, g_strdup (key));
+          }
+        task_data->store_live_bytes += record->length;
+        task_data->store_changed_bytes += record->payload_size;
+
+        g_hash_table_replace (
+            task_data->store_index,
+            g_strdup (key),
+            store_record_data_ref (record));
+      }
+  }
+done:
+  bz_clear_guard (&guard);
+
+  store_batch_clear (batch);
+
+  return result;
+}
+
+/* Returns the serialized entry stored under `key`, including
+ * one still waiting to be appended by the ingestion workers.
+ * Unless it was compressed or is pending, it points straight
+ * into a mapping of the store rather than a copy
+ */
+static GBytes *
+store_read (OngoingTaskData *task_data,
+            const char      *key,
+            GError         **error)
+{
+  g_autoptr (GError) local_error         = NULL;
+  g_autoptr (BzGuard) guard              = NULL;
+  StoreRecordData *record                = NULL;
+  g_autoptr (StoreRecordData) unverified = NULL;
+  g_autoptr (GBytes) bytes               = NULL;
+  guint16  codec                         = STORE_CODEC_NONE;
+  gsize    raw_size                      = 0;
+  gboolean stale                         = FALSE;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->ingest_mutex,
+                               &task_data->ingest_gate);
+  {
+    StoreBatchData  *batch    = task_data->ingest_batch;
+    StoreRecordData *pending  = NULL;
+    guint            position = 0;
+
+    position = GPOINTER_TO_UINT (g_hash_table_lookup (batch->positions, key));
+    if (position > 0)
+      {
+        pending  = g_ptr_array_index (batch->records, position - 1);
+        bytes    = g_bytes_new (
+            batch->buffer->data + pending->offset + pending->payload_offset,
+            pending->payload_size);
+        codec    = pending->codec;
+        raw_size = pending->raw_size;
+      }
+  }
+  bz_clear_guard (&guard);
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    StoreSegmentData *segment = task_data->segment;
+    guint64           offset  = 0;
+
+    /* What is pending is newer than anything stored */
+    if (bytes == NULL)
+      record = g_hash_table_lookup (task_data->store_index, key);
+    stale = record != NULL && record->stale;
+    if (record != NULL && !stale && segment != NULL)
+      {
+        offset = record->offset + record->payload_offset;
+
+        /* The file only ever grows, so mapping it again is
+         * only needed once a record lies past the mapping.
+         * Bytes handed out earlier keep the old one alive
+         */
+        if (segment->mapped == NULL ||
+            g_bytes_get_size (segment->mapped) < offset + record->payload_size)
+          {
+            g_autoptr (GMappedFile) mapped_file = NULL;
+
+            mapped_file = g_mapped_file_new_from_fd (segment->fd, FALSE, &local_error);
+            if (mapped_file != NULL)
+              {
+                g_clear_pointer (&segment->mapped, g_bytes_unref);
+                segment->mapped = g_mapped_file_get_bytes (mapped_file);
+              }
+          }
+
+        if (local_error == NULL)
+          {
+            bytes    = g_bytes_new_from_bytes (segment->mapped, offset, record->payload_size);
+            codec    = record->codec;
+            raw_size = record->raw_size;
+            if (!record->verified)
+              unverified = store_record_data_ref (record);
+          }
+      }
+  }
+  bz_clear_guard (&guard);
+
+  if (local_error != NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed to map the store to read %s: %s",
+                   key, local_error->message);
+      return NULL;
+    }
+  if (stale)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "What is cached for %s is out of date", key);
+      return NULL;
+    }
+  if (bytes == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "Nothing is cached for %s", key);
+      return NULL;
+    }
+
+  if (codec == STORE_CODEC_ZSTD_DICT)
+    {
+      g_autoptr (GBytes) decoded = NULL;
+
+      decoded = store_dict_decompress (
+          g_atomic_pointer_get (&task_data->store_dict),
+          bytes, raw_size, &local_error);
+      if (decoded == NULL)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "Failed to decompress %s: %s",
+                       key, local_error->message);
+          return NULL;
+        }
+
+      g_bytes_unref (bytes);
+      bytes = g_steal_pointer (&decoded);
+    }
+
+  /* The file may have been damaged since a previous session
+   * wrote it, so its records are checked the first time they
+   * are read. One which does not match is dropped for good
+   */
+  if (unverified != NULL)
+    {
+      g_autoptr (GChecksum) checksum = NULL;
+      guint8   digest[16]            = { 0 };
+      gsize    digest_len            = sizeof (digest);
+      gboolean matches               = FALSE;
+
+      checksum = g_checksum_new (G_CHECKSUM_MD5);
+      g_checksum_update (
+          checksum,
+          g_bytes_get_data (bytes, NULL),
+          g_bytes_get_size (bytes));
+      g_checksum_get_digest (checksum, digest, &digest_len);
+      matches = memcmp (digest, unverified->digest, sizeof (digest)) == 0;
+
+      BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                                   &task_data->store_mutex,
+                                   &task_data->store_gate);
+      {
+        if (matches)
+          unverified->verified = TRUE;
+        else if (g_hash_table_lookup (task_data->store_index, key) == unverified)
+          {
+            task_data->store_live_bytes -= unverified->length;
+            g_hash_table_remove (task_data->store_index, key);
+          }
+      }
+      bz_clear_guard (&guard);
+
+      if (!matches)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "The record of %s does not match its digest", key);
+          return NULL;
+        }
+    }
+
+  return g_steal_pointer (&bytes);
+}
+
+/* Rewrites the store with only the latest record of
+ * every key, compressing those which were stored before
+ * there was a dictionary. The records are copied without
+ * holding the store guard, which is only taken again to
+ * carry over whatever was appended meanwhile and swap the
+ * files. Only the cleanup sweep compacts, so there is
+ * never more than one compaction at a time
+ */
+static void
+store_compact (OngoingTaskData *task_data)
+{
+  g_autoptr (BzGuard) guard              = NULL;
+  g_autoptr (GError) local_error         = NULL;
+  g_autoptr (StoreSegmentData) segment   = NULL;
+  g_autofree char *path                  = NULL;
+  g_autoptr (StoreSegmentData) compacted = NULL;
+  g_autoptr (GPtrArray) keys             = NULL;
+  g_autoptr (GPtrArray) records          = NULL;
+  g_autoptr (GPtrArray) copies           = NULL;
+  g_autoptr (StoreBatchData) batch       = NULL;
+  StoreDictData     *dict                = NULL;
+  g_autofree guint8 *buffer              = NULL;
+  gsize              buffer_size         = 0;
+  guint64            base                = 0;
+  guint64            old_size            = 0;
+  guint              n_encoded           = 0;
+
+  keys    = g_ptr_array_new_with_free_func (g_free);
+  records = g_ptr_array_new_with_free_func (store_record_data_unref);
+  copies  = g_ptr_array_new_with_free_func (store_record_data_unref);
+  batch   = store_batch_new ();
+  dict    = g_atomic_pointer_get (&task_data->store_dict);
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    GHashTableIter iter  = { 0 };
+    gpointer       key   = NULL;
+    gpointer       value = NULL;
+
+    if (task_data->segment == NULL)
+      return;
+    segment = store_segment_data_ref (task_data->segment);
+    base    = segment->size;
+
+    g_hash_table_iter_init (&iter, task_data->store_index);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+      {
+        g_ptr_array_add (keys, g_strdup (key));
+        g_ptr_array_add (records, store_record_data_ref (value));
+      }
+  }
+  bz_clear_guard (&guard);
+
+  path      = g_strconcat (segment->path, ".compact", NULL);
+  compacted = store_create_segment (path, &local_error);
+  if (compacted == NULL)
+    {
+      g_warning ("Failed to compact entry cache: %s", local_error->message);
+      return;
+    }
+
+  /* Records before `base` are never written to again, so
+   * they are safe to read while appends carry on past it
+   */
+  for (guint i = 0; i < records->len; i++)
+    {
+      const char      *key             = NULL;
+      StoreRecordData *record          = NULL;
+      g_autoptr (StoreRecordData) copy = NULL;
+
+      key    = g_ptr_array_index (keys, i);
+      record = g_ptr_array_index (records, i);
+
+      if (record->length > buffer_size)
+        {
+          buffer_size = record->length;
+          buffer      = g_realloc (buffer, buffer_size);
+        }
+      if (!store_pread (segment->fd, buffer, record->length, record->offset))
+        goto fail;
+
+      if (dict != NULL &&
+          record->codec == STORE_CODEC_NONE)
+        {
+          g_autoptr (GBytes) raw     = NULL;
+          g_autoptr (GBytes) payload = NULL;
+          guint16 codec              = STORE_CODEC_NONE;
+
+          raw     = g_bytes_new_static (buffer + record->payload_offset, record->payload_size);
+          payload = store_encode_payload (task_data, raw, &codec);
+
+          if (codec != STORE_CODEC_NONE &&
+              store_batch_encode (
+                  batch, key, record->validator, record->digest,
+                  codec, record->raw_size, payload, NULL))
+            {
+              if (!store_pwrite (compacted->fd, batch->buffer->data, batch->buffer->len, compacted->size))
+                goto fail;
+
+              copy         = g_ptr_array_steal_index (batch->records, 0);
+              copy->offset = compacted->size;
+              store_batch_clear (batch);
+              n_encoded++;
+            }
+        }
+
+      if (copy == NULL)
+        {
+          if (!store_pwrite (compacted->fd, buffer, record->length, compacted->size))
+            goto fail;
+
+          copy                 = store_record_data_new ();
+          copy->offset         = compacted->size;
+          copy->length         = record->length;
+          copy->payload_offset = record->payload_offset;
+          copy->payload_size   = record->payload_size;
+          copy->raw_size       = record->raw_size;
+          copy->codec          = record->codec;
+          copy->validator      = g_strdup (record->validator);
+          memcpy (copy->digest, record->digest, sizeof (copy->digest));
+        }
+
+      compacted->size += copy->length;
+      g_ptr_array_add (copies, g_steal_pointer (&copy));
+    }
+
+  if (fdatasync (compacted->fd) != 0)
+    goto fail;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    GHashTableIter iter      = { 0 };
+    gpointer       value     = NULL;
+    guint64        tail      = 0;
+    guint64        tail_size = 0;
+
+    /* Nothing else replaces the segment, so
+     * this is still the one copied from
+     */
+    g_assert (task_data->segment == segment);
+
+    /* Whatever was appended meanwhile is carried over as
+     * is, superseded records included, in bounded chunks
+     */
+    tail      = compacted->size;
+    tail_size = segment->size - base;
+    if (buffer_size < COMPACT_CHUNK_BYTES)
+      {
+        buffer_size = COMPACT_CHUNK_BYTES;
+        buffer      = g_realloc (buffer, buffer_size);
+      }
+    for (guint64 done = 0; done < tail_size;)
+      {
+        gsize chunk = 0;
+
+        chunk = MIN (buffer_size, tail_size - done);
+        if (!store_pread (segment->fd, buffer, chunk, base + done) ||
+            !store_pwrite (compacted->fd, buffer, chunk, tail + done))
+          {
+            bz_clear_guard (&guard);
+            goto fail;
+          }
+        done += chunk;
+      }
+    compacted->size += tail_size;
+
+    if ((tail_size > 0 && fdatasync (compacted->fd) != 0) ||
+        rename (path, segment->path) != 0)
+      {
+        bz_clear_guard (&guard);
+        goto fail;
+      }
+
+    g_hash_table_iter_init (&iter, task_data->store_index);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+      {
+        StoreRecordData *record = value;
+
+        if (record->offset >= base)
+          record->offset = record->offset - base + tail;
+      }
+
+    /* Keys which were written again or dropped while
+     * copying already point elsewhere and are left be
+     */
+    for (guint i = 0; i < copies->len; i++)
+      {
+        const char      *key    = NULL;
+        StoreRecordData *record = NULL;
+        StoreRecordData *copy   = NULL;
+
+        key    = g_ptr_array_index (keys, i);
+        record = g_ptr_array_index (records, i);
+        copy   = g_ptr_array_index (copies, i);
+        if (g_hash_table_lookup (task_data->store_index, key) != record)
+          continue;
+
+        copy->stale    = record->stale;
+        copy->epoch    = record->epoch;
+        copy->verified = record->verified;
+        g_hash_table_replace (
+            task_data->store_index,
+            g_strdup (key),
+            store_record_data_ref (copy));
+      }
+
+    task_data->store_live_bytes = 0;
+    g_hash_table_iter_init (&iter, task_data->store_index);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+      task_data->store_live_bytes += ((StoreRecordData *) value)->length;
+
+    old_size = segment->size;
+    g_free (compacted->path);
+    compacted->path = g_strdup (segment->path);
+
+    task_data->store_written_bytes += compacted->size;
+    g_clear_pointer (&task_data->segment, store_segment_data_unref);
+    task_data->segment        = g_steal_pointer (&compacted);
+    task_data->store_unsynced = FALSE;
+
+    g_debug ("Compacted the entry cache store from %" G_GUINT64_FORMAT
+             " to %" G_GUINT64_FORMAT " bytes, compressing %d records",
+             old_size, task_data->segment->size, n_encoded);
+  }
+  bz_clear_guard (&guard);
+
+  return;
+
+fail:
+  g_warning ("Failed to compact entry cache: %s", g_strerror (errno));
+  unlink (path);
+}
+
+/* Drops every key which was neither written nor found
+ * current since the last call, adding them to `pruned`.
+ * Their records are left for compaction to throw out
+ */
+static void
+store_prune (OngoingTaskData *task_data,
+             GPtrArray       *pruned)
+{
+  g_autoptr (BzGuard) guard = NULL;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    GHashTableIter iter  = { 0 };
+    gpointer       key   = NULL;
+    gpointer       value = NULL;
+
+    g_hash_table_iter_init (&iter, task_data->store_index);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+      {
+        StoreRecordData *record = value;
+
+        if (record->epoch == task_data->store_epoch)
+          continue;
+
+        task_data->store_live_bytes -= record->length;
+        g_ptr_array_add (pruned, g_strdup (key));
+        g_hash_table_iter_remove (&iter);
+      }
+    task_data->store_epoch++;
+  }
+  bz_clear_guard (&guard);
+}
+
+/* Compacts the store once it has grown wasteful, makes
+ * sure appended records have hit the disk and trains a
+ * compression dictionary once there is enough to go on
+ */
+static void
+store_maintain (OngoingTaskData *task_data)
+{
+  g_autoptr (BzGuard) guard = NULL;
+  gboolean compact          = FALSE;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    if (task_data->segment == NULL)
+      return;
+
+    compact = task_data->segment->size >= COMPACT_MIN_BYTES &&
+              task_data->store_live_bytes * 2 < task_data->segment->size;
+  }
+  bz_clear_guard (&guard);
+
+  if (compact)
+    store_compact (task_data);
+  store_sync (task_data);
+  store_dict_maybe_train (task_data);
+}
+
+/* Makes sure appended records have hit the disk */
+static void
+store_sync (OngoingTaskData *task_data)
+{
+  g_autoptr (BzGuard) guard            = NULL;
+  g_autoptr (StoreSegmentData) segment = NULL;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    if (task_data->segment != NULL &&
+        task_data->store_unsynced)
+      segment = store_segment_data_ref (task_data->segment);
+    task_data->store_unsynced = FALSE;
+  }
+  bz_clear_guard (&guard);
+
+  if (segment != NULL &&
+      fdatasync (segment->fd) != 0)
+    g_warning ("Failed to sync %s: %s", segment->path, g_strerror (errno));
+}
+
+/* Hands out and resets how many bytes were written
+ * to the store since the last call
+ */
+static void
+store_take_write_stats (OngoingTaskData *task_data,
+                        guint64         *written_bytes,
+                        guint64         *changed_bytes)
+{
+  g_autoptr (BzGuard) guard = NULL;
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    if (written_bytes != NULL)
+      *written_bytes = task_data->store_written_bytes;
+    if (changed_bytes != NULL)
+      *changed_bytes = task_data->store_changed_bytes;
+    task_data->store_written_bytes = 0;
+    task_data->store_changed_bytes = 0;
+  }
+  bz_clear_guard (&guard);
+}
+
+/* Compresses `bytes` with the dictionary if there is one
+ * and it actually helps, setting `codec` to match
+ */
+static GBytes *
+store_encode_payload (OngoingTaskData *task_data,
+                      GBytes          *bytes,
+                      guint16         *codec)
+{
+  StoreDictData *dict           = NULL;
+  g_autoptr (GBytes) compressed = NULL;
+
+  dict = g_atomic_pointer_get (&task_data->store_dict);
+  if (dict != NULL)
+    compressed = store_dict_compress (dict, bytes);
+
+  if (compressed != NULL)
+    {
+      *codec = STORE_CODEC_ZSTD_DICT;
+      return g_steal_pointer (&compressed);
+    }
+
+  *codec = STORE_CODEC_NONE;
+  return g_bytes_ref (bytes);
+}
+
+#ifdef HAVE_ZSTD
+
+static void
+free_compress_context (gpointer ptr)
+{
+  ZSTD_freeCCtx (ptr);
+}
+
+static void
+free_decompress_context (gpointer ptr)
+{
+  ZSTD_freeDCtx (ptr);
+}
+
+/* Contexts are expensive to set up, so every
+ * thread keeps one of each around
+ */
+static GPrivate compress_context   = G_PRIVATE_INIT (free_compress_context);
+static GPrivate decompress_context = G_PRIVATE_INIT (free_decompress_context);
+
+static StoreDictData *
+store_dict_new_from_data (gconstpointer data,
+                          gsize         size)
+{
+  g_autoptr (StoreDictData) dict = NULL;
+
+  dict        = store_dict_data_new ();
+  dict->cdict = ZSTD_createCDict (data, size, DICT_LEVEL);
+  dict->ddict = ZSTD_createDDict (data, size);
+  if (dict->cdict == NULL || dict->ddict == NULL)
+    return NULL;
+
+  return g_steal_pointer (&dict);
+}
+
+#endif
+
+static void
+store_dict_free_codecs (gpointer cdict,
+                        gpointer ddict)
+{
+#ifdef HAVE_ZSTD
+  ZSTD_freeCDict (cdict);
+  ZSTD_freeDDict (ddict);
+#endif
+}
+
+/* Returns NULL if there is no dictionary at `path`
+ * or we were built without zstd
+ */
+static StoreDictData *
+store_dict_load (const char *path)
+{
+#ifdef HAVE_ZSTD
+  g_autofree char *contents = NULL;
+  gsize            length   = 0;
+
+  if (!g_file_get_contents (path, &contents, &length, NULL))
+    return NULL;
+
+  return store_dict_new_from_data (contents, length);
+#else
+  return NULL;
+#endif
+}
+
+/* Trains a dictionary on a sample of the stored entries
+ * once there are enough of them, then compacts the store
+ * so what is already there gets compressed as well
+ */
+static void
+store_dict_maybe_train (OngoingTaskData *task_data)
+{
+#ifdef HAVE_ZSTD
+  g_autoptr (BzGuard) guard       = NULL;
+  g_autoptr (GError) local_error  = NULL;
+  g_autoptr (GByteArray) samples  = NULL;
+  g_autoptr (GArray) sample_sizes = NULL;
+  g_autofree guint8 *dict_data    = NULL;
+  gsize              dict_size    = 0;
+  g_autofree char   *main_cache   = NULL;
+  g_autofree char   *path         = NULL;
+  g_autoptr (StoreDictData) dict  = NULL;
+  g_autoptr (GTimer) timer        = NULL;
+
+  samples      = g_byte_array_new ();
+  sample_sizes = g_array_new (FALSE, FALSE, sizeof (size_t));
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    GHashTableIter iter  = { 0 };
+    gpointer       value = NULL;
+
+    if (task_data->segment == NULL ||
+        task_data->store_dict != NULL ||
+        task_data->store_dict_attempted ||
+        g_hash_table_size (task_data->store_index) < DICT_MIN_SAMPLES)
+      return;
+    task_data->store_dict_attempted = TRUE;
+
+    g_hash_table_iter_init (&iter, task_data->store_index);
+    while (samples->len < DICT_SAMPLE_BYTES &&
+           g_hash_table_iter_next (&iter, NULL, &value))
+      {
+        StoreRecordData *record = value;
+        guint            start  = samples->len;
+        size_t           size   = record->payload_size;
+
+        if (record->codec != STORE_CODEC_NONE)
+          continue;
+
+        g_byte_array_set_size (samples, start + size);
+        if (!store_pread (task_data->segment->fd, samples->data + start, size,
+                          record->offset + record->payload_offset))
+          {
+            g_byte_array_set_size (samples, start);
+            continue;
+          }
+        g_array_append_val (sample_sizes, size);
+      }
+  }
+  bz_clear_guard (&guard);
+
+  if (sample_sizes->len < DICT_MIN_SAMPLES)
+    return;
+
+  /* Training takes a while, so the store
+   * stays usable in the meantime
+   */
+  timer     = g_timer_new ();
+  dict_data = g_malloc (DICT_MAX_BYTES);
+  dict_size = ZDICT_trainFromBuffer (
+      dict_data, DICT_MAX_BYTES,
+      samples->data,
+      (const size_t *) (gpointer) sample_sizes->data,
+      sample_sizes->len);
+  if (ZDICT_isError (dict_size))
+    {
+      g_warning ("Failed to train a dictionary for the entry cache: %s",
+                 ZDICT_getErrorName (dict_size));
+      return;
+    }
+
+  /* Records may only refer to the
+   * dictionary once it is on disk
+   */
+  main_cache = bz_dup_module_dir ();
+  path       = g_build_filename (main_cache, DICT_FILENAME, NULL);
+  if (!g_file_set_contents_full (
+          path, (const char *) dict_data, dict_size,
+          G_FILE_SET_CONTENTS_CONSISTENT | G_FILE_SET_CONTENTS_DURABLE,
+          0644, &local_error))
+    {
+      g_warning ("Failed to save the entry cache dictionary to %s: %s",
+                 path, local_error->message);
+      return;
+    }
+
+  dict = store_dict_new_from_data (dict_data, dict_size);
+  if (dict == NULL)
+    {
+      g_warning ("Failed to load the entry cache dictionary just trained");
+      unlink (path);
+      return;
+    }
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard,
+                               &task_data->store_mutex,
+                               &task_data->store_gate);
+  {
+    g_atomic_pointer_set (&task_data->store_dict, g_steal_pointer (&dict));
+  }
+  bz_clear_guard (&guard);
+
+  store_compact (task_data);
+
+  g_debug ("Trained a %" G_GSIZE_FORMAT " byte dictionary on %d entries "
+           "and compressed the entry cache with it in %0.2f seconds",
+           dict_size, sample_sizes->len, g_timer_elapsed (timer, NULL));
+#endif
+}
+
+static GBytes *
+store_dict_compress (StoreDictData *dict,
+                     GBytes        *bytes)
+{
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx         *context         = NULL;
+  gconstpointer      data            = NULL;
+  gsize              size            = 0;
+  gsize              bound           = 0;
+  gsize              compressed_size = 0;
+  g_autofree guint8 *buffer          = NULL;
+
+  data = g_bytes_get_data (bytes, &size);
+  if (size == 0)
+    return NULL;
+
+  context = g_private_get (&compress_context);
+  if (context == NULL)
+    {
+      context = ZSTD_createCCtx ();
+      g_private_set (&compress_context, context);
+    }
+
+  bound           = ZSTD_compressBound (size);
+  buffer          = g_malloc (bound);
+  compressed_size = ZSTD_compress_usingCDict (
+      context, buffer, bound, data, size, dict->cdict);
+  if (ZSTD_isError (compressed_size) ||
+      compressed_size >= size)
+    return NULL;
+
+  buffer = g_realloc (buffer, compressed_size);
+  return g_bytes_new_take (g_steal_pointer (&buffer), compressed_size);
+#else
+  return NULL;
+#endif
+}
+
+static GBytes *
+store_dict_decompress (StoreDictData *dict,
+                       GBytes        *bytes,
+                       gsize          raw_size,
+                       GError       **error)
+{
+#ifdef HAVE_ZSTD
+  ZSTD_DCtx         *context = NULL;
+  gconstpointer      data    = NULL;
+  gsize              size    = 0;
+  gsize              result  = 0;
+  g_autofree guint8 *buffer  = NULL;
+
+  if (dict == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "There is no dictionary to decompress with");
+      return NULL;
+    }
+
+  context = g_private_get (&decompress_context);
+  if (context == NULL)
+    {
+      context = ZSTD_createDCtx ();
+      g_private_set (&decompress_context, context);
+    }
+
+  data   = g_bytes_get_data (bytes, &size);
+  buffer = g_malloc (MAX (raw_size, 1));
+  result = ZSTD_decompress_usingDDict (
+      context, buffer, raw_size, data, size, dict->ddict);
+  if (ZSTD_isError (result))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "%s", ZSTD_getErrorName (result));
+      return NULL;
+    }
+  if (result != raw_size)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Expected %" G_GSIZE_FORMAT " bytes but got %" G_GSIZE_FORMAT,
+                   raw_size, result);
+      return NULL;
+    }
+
+  return g_bytes_new_take (g_steal_pointer (&buffer), raw_size);
+#else
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "Compressed records need zstd support");
+  return NULL;
+#endif
+}
+
 /* End of bz-entry-cache-manager.c */
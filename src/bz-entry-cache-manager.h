@@ -52,10 +52,29 @@ DexFuture *
 bz_entry_cache_manager_add (BzEntryCacheManager *self,
                             BzEntry             *entry);
 
+DexFuture *
+bz_entry_cache_manager_queue (BzEntryCacheManager *self,
+                              BzEntry             *entry);
+
+DexFuture *
+bz_entry_cache_manager_flush (BzEntryCacheManager *self);
+
 DexFuture *
 bz_entry_cache_manager_get (BzEntryCacheManager *self,
                             const char          *unique_id);
 
+DexFuture *
+bz_entry_cache_manager_get_many (BzEntryCacheManager *self,
+                                 GPtrArray           *unique_ids);
+
+void
+bz_entry_cache_manager_prefetch (BzEntryCacheManager *self,
+                                 const char          *unique_id);
+
+void
+bz_entry_cache_manager_cancel_prefetch (BzEntryCacheManager *self,
+                                        const char          *unique_id);
+
 G_END_DECLS
 
 /* End of bz-entry-cache-manager.h */
@@ -30,6 +30,7 @@ struct _BzEntryGroup
   GObject parent_instance;
 
   BzApplicationMapFactory *factory;
+  BzEntryCacheManager     *cache;
 
   GListStore   *store;
   char         *id;
@@ -110,6 +111,7 @@ bz_entry_group_dispose (GObject *object)
   BzEntryGroup *self = BZ_ENTRY_GROUP (object);
 
   g_clear_object (&self->factory);
+  g_clear_object (&self->cache);
   g_clear_object (&self->store);
   g_clear_pointer (&self->id, g_free);
   g_clear_pointer (&self->title, g_free);
@@ -398,15 +400,20 @@ bz_entry_group_init (BzEntryGroup *self)
   g_weak_ref_init (&self->ui_entry, NULL);
 }
 
+/* `cache` is optional and only used for prefetching */
 BzEntryGroup *
-bz_entry_group_new (BzApplicationMapFactory *factory)
+bz_entry_group_new (BzApplicationMapFactory *factory,
+                    BzEntryCacheManager     *cache)
 {
   BzEntryGroup *group = NULL;
 
   g_return_val_if_fail (BZ_IS_APPLICATION_MAP_FACTORY (factory), NULL);
+  g_return_val_if_fail (cache == NULL || BZ_IS_ENTRY_CACHE_MANAGER (cache), NULL);
 
   group          = g_object_new (BZ_TYPE_ENTRY_GROUP, NULL);
   group->factory = g_object_ref (factory);
+  if (cache != NULL)
+    group->cache = g_object_ref (cache);
 
   return group;
 }
@@ -545,6 +552,45 @@ bz_entry_group_dup_ui_entry_id (BzEntryGroup *self)
     return NULL;
 }
 
+/* Hints that the UI entry will likely be asked for soon,
+ * for instance because a tile showing this group was bound
+ */
+void
+bz_entry_group_prefetch_ui_entry (BzEntryGroup *self)
+{
+  g_autoptr (BzResult) result    = NULL;
+  g_autoptr (GtkStringObject) id = NULL;
+
+  g_return_if_fail (BZ_IS_ENTRY_GROUP (self));
+
+  if (self->cache == NULL ||
+      g_list_model_get_n_items (G_LIST_MODEL (self->store)) == 0)
+    return;
+
+  /* Somebody is already resolving it */
+  result = g_weak_ref_get (&self->ui_entry);
+  if (result != NULL)
+    return;
+
+  id = g_list_model_get_item (G_LIST_MODEL (self->store), 0);
+  bz_entry_cache_manager_prefetch (self->cache, gtk_string_object_get_string (id));
+}
+
+void
+bz_entry_group_cancel_prefetch_ui_entry (BzEntryGroup *self)
+{
+  g_autoptr (GtkStringObject) id = NULL;
+
+  g_return_if_fail (BZ_IS_ENTRY_GROUP (self));
+
+  if (self->cache == NULL ||
+      g_list_model_get_n_items (G_LIST_MODEL (self->store)) == 0)
+    return;
+
+  id = g_list_model_get_item (G_LIST_MODEL (self->store), 0);
+  bz_entry_cache_manager_cancel_prefetch (self->cache, gtk_string_object_get_string (id));
+}
+
 int
 bz_entry_group_get_installable (BzEntryGroup *self)
 {
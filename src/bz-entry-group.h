@@ -21,6 +21,7 @@
 #pragma once
 
 #include "bz-application-map-factory.h"
+#include "bz-entry-cache-manager.h"
 #include "bz-entry.h"
 #include "bz-result.h"
 
@@ -30,7 +31,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (BzEntryGroup, bz_entry_group, BZ, ENTRY_GROUP, GObject)
 
 BzEntryGroup *
-bz_entry_group_new (BzApplicationMapFactory *factory);
+bz_entry_group_new (BzApplicationMapFactory *factory,
+                    BzEntryCacheManager     *cache);
 
 GListModel *
 bz_entry_group_get_model (BzEntryGroup *self);
@@ -77,6 +79,12 @@ bz_entry_group_dup_ui_entry (BzEntryGroup *self);
 char *
 bz_entry_group_dup_ui_entry_id (BzEntryGroup *self);
 
+void
+bz_entry_group_prefetch_ui_entry (BzEntryGroup *self);
+
+void
+bz_entry_group_cancel_prefetch_ui_entry (BzEntryGroup *self);
+
 int
 bz_entry_group_get_installable (BzEntryGroup *self);
 
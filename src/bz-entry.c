@@ -120,6 +120,17 @@ typedef struct
 
   GHashTable *flathub_prop_queries;
   DexFuture  *mini_icon_future;
+
+  /* Bumped whenever something which is
+   * serialized might have changed
+   */
+  guint generation;
+
+  /* Kept as they were found in the cache until
+   * someone asks for the lists they describe
+   */
+  GVariant *deferred_share_urls;
+  GVariant *deferred_version_history;
 } BzEntryPrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (BzEntry, bz_entry, G_TYPE_OBJECT);
@@ -213,15 +224,24 @@ download_stats_per_country_foreach (JsonObject  *object,
                                     JsonNode    *member_node,
                                     GListStore  *store);
 
-static gboolean
-maybe_save_paintable (BzEntryPrivate  *priv,
-                      const char      *key,
-                      GdkPaintable    *paintable,
-                      GVariantBuilder *builder);
+static GVariant *
+save_paintable (GdkPaintable *paintable);
 
 static GdkPaintable *
 make_async_texture (GVariant *parse);
 
+static GListModel *
+share_urls_from_variant (GVariant *value);
+
+static GListModel *
+version_history_from_variant (GVariant *value);
+
+static void
+ensure_share_urls (BzEntryPrivate *priv);
+
+static void
+ensure_version_history (BzEntryPrivate *priv);
+
 static DexFuture *
 icon_paintable_future_then (DexFuture *future,
                             GWeakRef  *wr);
@@ -351,6 +371,7 @@ bz_entry_get_property (GObject    *object,
       g_value_set_object (value, priv->screenshot_paintables);
       break;
     case PROP_SHARE_URLS:
+      ensure_share_urls (priv);
       g_value_set_object (value, priv->share_urls);
       break;
     case PROP_DONATION_URL:
@@ -369,6 +390,7 @@ bz_entry_get_property (GObject    *object,
       g_value_set_string (value, priv->ratings_summary);
       break;
     case PROP_VERSION_HISTORY:
+      ensure_version_history (priv);
       g_value_set_object (value, priv->version_history);
       break;
     case PROP_LIGHT_ACCENT_COLOR:
@@ -431,6 +453,8 @@ bz_entry_set_property (GObject      *object,
   BzEntry        *self = BZ_ENTRY (object);
   BzEntryPrivate *priv = bz_entry_get_instance_private (self);
 
+  g_atomic_int_inc (&priv->generation);
+
   switch (prop_id)
     {
     case PROP_INSTALLED:
@@ -532,6 +556,7 @@ bz_entry_set_property (GObject      *object,
       priv->screenshot_paintables = g_value_dup_object (value);
       break;
     case PROP_SHARE_URLS:
+      g_clear_pointer (&priv->deferred_share_urls, g_variant_unref);
       g_clear_object (&priv->share_urls);
       priv->share_urls = g_value_dup_object (value);
       break;
@@ -555,6 +580,7 @@ bz_entry_set_property (GObject      *object,
       priv->ratings_summary = g_value_dup_string (value);
       break;
     case PROP_VERSION_HISTORY:
+      g_clear_pointer (&priv->deferred_version_history, g_variant_unref);
       g_clear_object (&priv->version_history);
       priv->version_history = g_value_dup_object (value);
       break;
@@ -970,264 +996,623 @@ bz_entry_init (BzEntry *self)
   priv->hold = 0;
 }
 
-static void
-bz_entry_real_serialize (BzSerializable  *serializable,
-                         GVariantBuilder *builder)
+/* Every value an entry stores, in the order the compact
+ * encoding lays them out. Append new fields at the end and
+ * bump COMPACT_VERSION when changing anything else
+ */
+#define COMPACT_VERSION 1
+
+typedef enum
+{
+  FIELD_INSTALLED = 0,
+  FIELD_KINDS,
+  FIELD_ADDONS,
+  FIELD_ID,
+  FIELD_UNIQUE_ID,
+  FIELD_UNIQUE_ID_CHECKSUM,
+  FIELD_TITLE,
+  FIELD_EOL,
+  FIELD_DESCRIPTION,
+  FIELD_LONG_DESCRIPTION,
+  FIELD_REMOTE_REPO_NAME,
+  FIELD_URL,
+  FIELD_SIZE,
+  FIELD_ICON_PAINTABLE,
+  FIELD_MINI_ICON,
+  FIELD_REMOTE_REPO_ICON,
+  FIELD_SEARCH_TOKENS,
+  FIELD_METADATA_LICENSE,
+  FIELD_PROJECT_LICENSE,
+  FIELD_IS_FLOSS,
+  FIELD_PROJECT_GROUP,
+  FIELD_DEVELOPER,
+  FIELD_DEVELOPER_ID,
+  FIELD_SCREENSHOT_PAINTABLES,
+  FIELD_SHARE_URLS,
+  FIELD_DONATION_URL,
+  FIELD_FORGE_URL,
+  FIELD_VERSION_HISTORY,
+  FIELD_LIGHT_ACCENT_COLOR,
+  FIELD_DARK_ACCENT_COLOR,
+  FIELD_IS_MOBILE_FRIENDLY,
+  FIELD_REQUIRED_CONTROLS,
+  FIELD_RECOMMENDED_CONTROLS,
+  FIELD_SUPPORTED_CONTROLS,
+  FIELD_MIN_DISPLAY_LENGTH,
+  FIELD_MAX_DISPLAY_LENGTH,
+  FIELD_AGE_RATING,
+  FIELD_IS_FLATHUB,
+  FIELD_VERIFIED,
+  FIELD_DOWNLOAD_STATS,
+  FIELD_RECENT_DOWNLOADS,
+
+  N_FIELDS,
+} Field;
+
+static const struct
+{
+  const char *key;
+  const char *type;
+} fields[N_FIELDS] = {
+  [FIELD_INSTALLED]             = {             "installed",           "b" },
+  [FIELD_KINDS]                 = {                 "kinds",           "u" },
+  [FIELD_ADDONS]                = {                "addons",          "as" },
+  [FIELD_ID]                    = {                    "id",           "s" },
+  [FIELD_UNIQUE_ID]             = {             "unique-id",           "s" },
+  [FIELD_UNIQUE_ID_CHECKSUM]    = {    "unique-id-checksum",           "s" },
+  [FIELD_TITLE]                 = {                 "title",           "s" },
+  [FIELD_EOL]                   = {                   "eol",           "s" },
+  [FIELD_DESCRIPTION]           = {           "description",           "s" },
+  [FIELD_LONG_DESCRIPTION]      = {      "long-description",           "s" },
+  [FIELD_REMOTE_REPO_NAME]      = {      "remote-repo-name",           "s" },
+  [FIELD_URL]                   = {                   "url",           "s" },
+  [FIELD_SIZE]                  = {                  "size",           "t" },
+  [FIELD_ICON_PAINTABLE]        = {        "icon-paintable",       "(sms)" },
+  [FIELD_MINI_ICON]             = {             "mini-icon",           "v" },
+  [FIELD_REMOTE_REPO_ICON]      = {      "remote-repo-icon",       "(sms)" },
+  [FIELD_SEARCH_TOKENS]         = {         "search-tokens",          "as" },
+  [FIELD_METADATA_LICENSE]      = {      "metadata-license",           "s" },
+  [FIELD_PROJECT_LICENSE]       = {       "project-license",           "s" },
+  [FIELD_IS_FLOSS]              = {              "is-floss",           "b" },
+  [FIELD_PROJECT_GROUP]         = {         "project-group",           "s" },
+  [FIELD_DEVELOPER]             = {             "developer",           "s" },
+  [FIELD_DEVELOPER_ID]          = {          "developer-id",           "s" },
+  [FIELD_SCREENSHOT_PAINTABLES] = { "screenshot-paintables",       "a{sv}" },
+  [FIELD_SHARE_URLS]            = {            "share-urls",      "a(sss)" },
+  [FIELD_DONATION_URL]          = {          "donation-url",           "s" },
+  [FIELD_FORGE_URL]             = {             "forge-url",           "s" },
+  [FIELD_VERSION_HISTORY]       = {       "version-history", "a(msmvtmsms)" },
+  [FIELD_LIGHT_ACCENT_COLOR]    = {    "light-accent-color",           "s" },
+  [FIELD_DARK_ACCENT_COLOR]     = {     "dark-accent-color",           "s" },
+  [FIELD_IS_MOBILE_FRIENDLY]    = {    "is-mobile-friendly",           "b" },
+  [FIELD_REQUIRED_CONTROLS]     = {     "required-controls",           "u" },
+  [FIELD_RECOMMENDED_CONTROLS]  = {  "recommended-controls",           "u" },
+  [FIELD_SUPPORTED_CONTROLS]    = {    "supported-controls",           "u" },
+  [FIELD_MIN_DISPLAY_LENGTH]    = {    "min-display-length",           "i" },
+  [FIELD_MAX_DISPLAY_LENGTH]    = {    "max-display-length",           "i" },
+  [FIELD_AGE_RATING]            = {            "age-rating",           "i" },
+  [FIELD_IS_FLATHUB]            = {            "is-flathub",           "b" },
+  [FIELD_VERIFIED]              = {              "verified",           "b" },
+  [FIELD_DOWNLOAD_STATS]        = {        "download-stats",      "a(ddms)" },
+  [FIELD_RECENT_DOWNLOADS]      = {      "recent-downloads",           "i" },
+};
+
+static GVariant *
+new_string_or_null (const char *string)
 {
-  BzEntry        *self = BZ_ENTRY (serializable);
-  BzEntryPrivate *priv = bz_entry_get_instance_private (self);
+  return string != NULL ? g_variant_new_string (string) : NULL;
+}
 
-  g_variant_builder_add (builder, "{sv}", "installed", g_variant_new_boolean (priv->installed));
-  g_variant_builder_add (builder, "{sv}", "kinds", g_variant_new_uint32 (priv->kinds));
-  if (priv->addons != NULL)
+static gboolean
+flathub_prop_was_queried (BzEntryPrivate *priv,
+                          int             prop)
+{
+  return priv->is_flathub &&
+         priv->flathub_prop_queries != NULL &&
+         g_hash_table_contains (priv->flathub_prop_queries, GINT_TO_POINTER (prop));
+}
+
+/* Returns the value stored for `field`, or NULL if there is
+ * nothing to store. The result may be floating
+ */
+static GVariant *
+serialize_field (BzEntryPrivate *priv,
+                 Field           field)
+{
+  switch (field)
     {
-      guint n_items = 0;
+    case FIELD_INSTALLED:
+      return g_variant_new_boolean (priv->installed);
+    case FIELD_KINDS:
+      return g_variant_new_uint32 (priv->kinds);
+    case FIELD_ADDONS:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
+        guint n_items                           = 0;
 
-      n_items = g_list_model_get_n_items (priv->addons);
-      if (n_items > 0)
-        {
-          g_autoptr (GVariantBuilder) sub_builder = NULL;
+        if (priv->addons == NULL)
+          return NULL;
+        n_items = g_list_model_get_n_items (priv->addons);
+        if (n_items == 0)
+          return NULL;
 
-          sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
-          for (guint i = 0; i < n_items; i++)
-            {
-              g_autoptr (GtkStringObject) string = NULL;
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+        for (guint i = 0; i < n_items; i++)
+          {
+            g_autoptr (GtkStringObject) string = NULL;
 
-              string = g_list_model_get_item (priv->addons, i);
-              g_variant_builder_add (sub_builder, "s", gtk_string_object_get_string (string));
-            }
+            string = g_list_model_get_item (priv->addons, i);
+            g_variant_builder_add (sub_builder, "s", gtk_string_object_get_string (string));
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_ID:
+      return new_string_or_null (priv->id);
+    case FIELD_UNIQUE_ID:
+      return new_string_or_null (priv->unique_id);
+    case FIELD_UNIQUE_ID_CHECKSUM:
+      return new_string_or_null (priv->unique_id_checksum);
+    case FIELD_TITLE:
+      return new_string_or_null (priv->title);
+    case FIELD_EOL:
+      return new_string_or_null (priv->eol);
+    case FIELD_DESCRIPTION:
+      return new_string_or_null (priv->description);
+    case FIELD_LONG_DESCRIPTION:
+      return new_string_or_null (priv->long_description);
+    case FIELD_REMOTE_REPO_NAME:
+      return new_string_or_null (priv->remote_repo_name);
+    case FIELD_URL:
+      return new_string_or_null (priv->url);
+    case FIELD_SIZE:
+      return priv->size > 0 ? g_variant_new_uint64 (priv->size) : NULL;
+    case FIELD_ICON_PAINTABLE:
+      return priv->icon_paintable != NULL ? save_paintable (priv->icon_paintable) : NULL;
+    case FIELD_MINI_ICON:
+      return priv->mini_icon != NULL ? g_icon_serialize (priv->mini_icon) : NULL;
+    case FIELD_REMOTE_REPO_ICON:
+      return priv->remote_repo_icon != NULL ? save_paintable (priv->remote_repo_icon) : NULL;
+    case FIELD_SEARCH_TOKENS:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
 
-          g_variant_builder_add (builder, "{sv}", "addons", g_variant_builder_end (sub_builder));
-        }
-    }
-  if (priv->id != NULL)
-    g_variant_builder_add (builder, "{sv}", "id", g_variant_new_string (priv->id));
-  if (priv->unique_id != NULL)
-    g_variant_builder_add (builder, "{sv}", "unique-id", g_variant_new_string (priv->unique_id));
-  if (priv->unique_id_checksum != NULL)
-    g_variant_builder_add (builder, "{sv}", "unique-id-checksum", g_variant_new_string (priv->unique_id_checksum));
-  if (priv->title != NULL)
-    g_variant_builder_add (builder, "{sv}", "title", g_variant_new_string (priv->title));
-  if (priv->eol != NULL)
-    g_variant_builder_add (builder, "{sv}", "eol", g_variant_new_string (priv->eol));
-  if (priv->description != NULL)
-    g_variant_builder_add (builder, "{sv}", "description", g_variant_new_string (priv->description));
-  if (priv->long_description != NULL)
-    g_variant_builder_add (builder, "{sv}", "long-description", g_variant_new_string (priv->long_description));
-  if (priv->remote_repo_name != NULL)
-    g_variant_builder_add (builder, "{sv}", "remote-repo-name", g_variant_new_string (priv->remote_repo_name));
-  if (priv->url != NULL)
-    g_variant_builder_add (builder, "{sv}", "url", g_variant_new_string (priv->url));
-  if (priv->size > 0)
-    g_variant_builder_add (builder, "{sv}", "size", g_variant_new_uint64 (priv->size));
-  if (priv->icon_paintable != NULL)
-    maybe_save_paintable (priv, "icon-paintable", priv->icon_paintable, builder);
-  if (priv->mini_icon != NULL)
-    {
-      g_autoptr (GVariant) serialized = NULL;
+        if (priv->search_tokens == NULL || priv->search_tokens->len == 0)
+          return NULL;
 
-      serialized = g_icon_serialize (priv->mini_icon);
-      g_variant_builder_add (builder, "{sv}", "mini-icon", serialized);
-    }
-  if (priv->remote_repo_icon != NULL)
-    maybe_save_paintable (priv, "remote-repo-icon", priv->remote_repo_icon, builder);
-  if (priv->search_tokens != NULL && priv->search_tokens->len > 0)
-    {
-      g_autoptr (GVariantBuilder) sub_builder = NULL;
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+        for (guint i = 0; i < priv->search_tokens->len; i++)
+          {
+            const char *token = NULL;
 
-      sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
-      for (guint i = 0; i < priv->search_tokens->len; i++)
-        {
-          const char *token = NULL;
+            token = g_ptr_array_index (priv->search_tokens, i);
+            g_variant_builder_add (sub_builder, "s", token);
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_METADATA_LICENSE:
+      return new_string_or_null (priv->metadata_license);
+    case FIELD_PROJECT_LICENSE:
+      return new_string_or_null (priv->project_license);
+    case FIELD_IS_FLOSS:
+      return g_variant_new_boolean (priv->is_floss);
+    case FIELD_PROJECT_GROUP:
+      return new_string_or_null (priv->project_group);
+    case FIELD_DEVELOPER:
+      return new_string_or_null (priv->developer);
+    case FIELD_DEVELOPER_ID:
+      return new_string_or_null (priv->developer_id);
+    case FIELD_SCREENSHOT_PAINTABLES:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
+        guint n_items                           = 0;
 
-          token = g_ptr_array_index (priv->search_tokens, i);
-          g_variant_builder_add (sub_builder, "s", token);
-        }
-      g_variant_builder_add (builder, "{sv}", "search-tokens", g_variant_builder_end (sub_builder));
+        if (priv->screenshot_paintables == NULL)
+          return NULL;
+        n_items = g_list_model_get_n_items (priv->screenshot_paintables);
+        if (n_items == 0)
+          return NULL;
+
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
+        for (guint i = 0; i < n_items; i++)
+          {
+            g_autoptr (GdkPaintable) paintable = NULL;
+            g_autofree char *key               = NULL;
+            GVariant        *saved             = NULL;
+
+            paintable = g_list_model_get_item (priv->screenshot_paintables, i);
+            key       = g_strdup_printf ("screenshot_%d.png", i);
+
+            saved = save_paintable (paintable);
+            if (saved != NULL)
+              g_variant_builder_add (sub_builder, "{sv}", key, saved);
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_SHARE_URLS:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
+        guint n_items                           = 0;
+
+        if (priv->deferred_share_urls != NULL)
+          return g_variant_ref (priv->deferred_share_urls);
+        if (priv->share_urls == NULL)
+          return NULL;
+        n_items = g_list_model_get_n_items (priv->share_urls);
+        if (n_items == 0)
+          return NULL;
+
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sss)"));
+        for (guint i = 0; i < n_items; i++)
+          {
+            g_autoptr (BzUrl) url = NULL;
+            const char *name      = NULL;
+            const char *url_str   = NULL;
+            const char *icon_name = NULL;
+
+            url       = g_list_model_get_item (priv->share_urls, i);
+            name      = bz_url_get_name (url);
+            url_str   = bz_url_get_url (url);
+            icon_name = bz_url_get_icon_name (url);
+            g_variant_builder_add (sub_builder, "(sss)", name, url_str, icon_name ? icon_name : "");
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_DONATION_URL:
+      return new_string_or_null (priv->donation_url);
+    case FIELD_FORGE_URL:
+      return new_string_or_null (priv->forge_url);
+    case FIELD_VERSION_HISTORY:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
+        guint n_items                           = 0;
+
+        if (priv->deferred_version_history != NULL)
+          return g_variant_ref (priv->deferred_version_history);
+        if (priv->version_history == NULL)
+          return NULL;
+        n_items = g_list_model_get_n_items (priv->version_history);
+        if (n_items == 0)
+          return NULL;
+
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(msmvtmsms)"));
+        for (guint i = 0; i < n_items; i++)
+          {
+            g_autoptr (BzRelease) release              = NULL;
+            GListModel *issues                         = NULL;
+            g_autoptr (GVariantBuilder) issues_builder = NULL;
+            guint       n_issues                       = 0;
+            guint64     timestamp                      = 0;
+            const char *url                            = NULL;
+            const char *version                        = NULL;
+            const char *description                    = NULL;
+
+            release     = g_list_model_get_item (priv->version_history, i);
+            issues      = bz_release_get_issues (release);
+            timestamp   = bz_release_get_timestamp (release);
+            url         = bz_release_get_url (release);
+            version     = bz_release_get_version (release);
+            description = bz_release_get_description (release);
+
+            if (issues != NULL)
+              {
+                n_issues = g_list_model_get_n_items (issues);
+                if (n_issues > 0)
+                  {
+                    issues_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(msms)"));
+                    for (guint j = 0; j < n_issues; j++)
+                      {
+                        g_autoptr (BzIssue) issue = NULL;
+                        const char *issue_id      = NULL;
+                        const char *issue_url     = NULL;
+
+                        issue     = g_list_model_get_item (issues, j);
+                        issue_id  = bz_issue_get_id (issue);
+                        issue_url = bz_issue_get_url (issue);
+
+                        g_variant_builder_add (issues_builder, "(msms)", issue_id, issue_url);
+                      }
+                  }
+              }
+
+            g_variant_builder_add (
+                sub_builder,
+                "(msmvtmsms)",
+                description,
+                issues_builder != NULL
+                    ? g_variant_builder_end (issues_builder)
+                    : NULL,
+                timestamp,
+                url,
+                version);
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_LIGHT_ACCENT_COLOR:
+      return new_string_or_null (priv->light_accent_color);
+    case FIELD_DARK_ACCENT_COLOR:
+      return new_string_or_null (priv->dark_accent_color);
+    case FIELD_IS_MOBILE_FRIENDLY:
+      return g_variant_new_boolean (priv->is_mobile_friendly);
+    case FIELD_REQUIRED_CONTROLS:
+      return priv->required_controls != BZ_CONTROL_NONE ? g_variant_new_uint32 (priv->required_controls) : NULL;
+    case FIELD_RECOMMENDED_CONTROLS:
+      return priv->recommended_controls != BZ_CONTROL_NONE ? g_variant_new_uint32 (priv->recommended_controls) : NULL;
+    case FIELD_SUPPORTED_CONTROLS:
+      return priv->supported_controls != BZ_CONTROL_NONE ? g_variant_new_uint32 (priv->supported_controls) : NULL;
+    case FIELD_MIN_DISPLAY_LENGTH:
+      return priv->min_display_length > 0 ? g_variant_new_int32 (priv->min_display_length) : NULL;
+    case FIELD_MAX_DISPLAY_LENGTH:
+      return priv->max_display_length > 0 ? g_variant_new_int32 (priv->max_display_length) : NULL;
+    case FIELD_AGE_RATING:
+      return g_variant_new_int32 (priv->age_rating);
+    case FIELD_IS_FLATHUB:
+      return g_variant_new_boolean (priv->is_flathub);
+    case FIELD_VERIFIED:
+      return flathub_prop_was_queried (priv, PROP_VERIFIED) ? g_variant_new_boolean (priv->verified) : NULL;
+    case FIELD_DOWNLOAD_STATS:
+      {
+        g_autoptr (GVariantBuilder) sub_builder = NULL;
+        guint n_items                           = 0;
+
+        if (!flathub_prop_was_queried (priv, PROP_DOWNLOAD_STATS) ||
+            priv->download_stats == NULL)
+          return NULL;
+        n_items = g_list_model_get_n_items (priv->download_stats);
+        if (n_items == 0)
+          return NULL;
+
+        sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ddms)"));
+        for (guint i = 0; i < n_items; i++)
+          {
+            g_autoptr (BzDataPoint) point = NULL;
+            double      independent       = 0.0;
+            double      dependent         = 0.0;
+            const char *label             = NULL;
+
+            point       = g_list_model_get_item (priv->download_stats, i);
+            independent = bz_data_point_get_independent (point);
+            dependent   = bz_data_point_get_dependent (point);
+            label       = bz_data_point_get_label (point);
+
+            g_variant_builder_add (sub_builder, "(ddms)", independent, dependent, label);
+          }
+        return g_variant_builder_end (sub_builder);
+      }
+    case FIELD_RECENT_DOWNLOADS:
+      return flathub_prop_was_queried (priv, PROP_RECENT_DOWNLOADS) ? g_variant_new_int32 (priv->recent_downloads) : NULL;
+    case N_FIELDS:
+    default:
+      g_assert_not_reached ();
     }
-  if (priv->metadata_license != NULL)
-    g_variant_builder_add (builder, "{sv}", "metadata-license", g_variant_new_string (priv->metadata_license));
-  if (priv->project_license != NULL)
-    g_variant_builder_add (builder, "{sv}", "project-license", g_variant_new_string (priv->project_license));
-  g_variant_builder_add (builder, "{sv}", "is-floss", g_variant_new_boolean (priv->is_floss));
-  if (priv->project_group != NULL)
-    g_variant_builder_add (builder, "{sv}", "project-group", g_variant_new_string (priv->project_group));
-  if (priv->developer != NULL)
-    g_variant_builder_add (builder, "{sv}", "developer", g_variant_new_string (priv->developer));
-  if (priv->developer_id != NULL)
-    g_variant_builder_add (builder, "{sv}", "developer-id", g_variant_new_string (priv->developer_id));
-  if (priv->screenshot_paintables != NULL)
+}
+
+/* `value` is known to be of the type of `field` */
+static void
+deserialize_field (BzEntryPrivate *priv,
+                   Field           field,
+                   GVariant       *value)
+{
+  switch (field)
     {
-      guint n_items = 0;
+    case FIELD_INSTALLED:
+      priv->installed = g_variant_get_boolean (value);
+      break;
+    case FIELD_KINDS:
+      priv->kinds = g_variant_get_uint32 (value);
+      break;
+    case FIELD_ADDONS:
+      {
+        g_autoptr (GListStore) store        = NULL;
+        g_autoptr (GVariantIter) addon_iter = NULL;
 
-      n_items = g_list_model_get_n_items (priv->screenshot_paintables);
-      if (n_items > 0)
-        {
-          g_autoptr (GVariantBuilder) sub_builder = NULL;
+        store = g_list_store_new (GTK_TYPE_STRING_OBJECT);
 
-          sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
-          for (guint i = 0; i < n_items; i++)
-            {
-              g_autoptr (GdkPaintable) paintable = NULL;
-              g_autofree char *key               = NULL;
+        addon_iter = g_variant_iter_new (value);
+        for (;;)
+          {
+            g_autofree char *unique_id         = NULL;
+            g_autoptr (GtkStringObject) string = NULL;
 
-              paintable = g_list_model_get_item (priv->screenshot_paintables, i);
-              key       = g_strdup_printf ("screenshot_%d.png", i);
+            if (!g_variant_iter_next (addon_iter, "s", &unique_id))
+              break;
+            string = gtk_string_object_new (unique_id);
+            g_list_store_append (store, string);
+          }
 
-              maybe_save_paintable (priv, key, paintable, sub_builder);
-            }
+        priv->addons = G_LIST_MODEL (g_steal_pointer (&store));
+      }
+      break;
+    case FIELD_ID:
+      priv->id = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_UNIQUE_ID:
+      priv->unique_id = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_UNIQUE_ID_CHECKSUM:
+      priv->unique_id_checksum = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_TITLE:
+      priv->title = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_EOL:
+      priv->eol = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_DESCRIPTION:
+      priv->description = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_LONG_DESCRIPTION:
+      priv->long_description = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_REMOTE_REPO_NAME:
+      priv->remote_repo_name = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_URL:
+      priv->url = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_SIZE:
+      priv->size = g_variant_get_uint64 (value);
+      break;
+    case FIELD_ICON_PAINTABLE:
+      priv->icon_paintable = make_async_texture (value);
+      break;
+    case FIELD_MINI_ICON:
+      priv->mini_icon = g_icon_deserialize (value);
+      break;
+    case FIELD_REMOTE_REPO_ICON:
+      priv->remote_repo_icon = make_async_texture (value);
+      break;
+    case FIELD_SEARCH_TOKENS:
+      {
+        g_autoptr (GPtrArray) search_tokens = NULL;
+        g_autoptr (GVariantIter) token_iter = NULL;
 
-          g_variant_builder_add (builder, "{sv}", "screenshot-paintables", g_variant_builder_end (sub_builder));
-        }
+        search_tokens = g_ptr_array_new_with_free_func (g_free);
+
+        token_iter = g_variant_iter_new (value);
+        for (;;)
+          {
+            g_autofree char *token = NULL;
+
+            if (!g_variant_iter_next (token_iter, "s", &token))
+              break;
+            g_ptr_array_add (search_tokens, g_steal_pointer (&token));
+          }
+        priv->search_tokens = g_steal_pointer (&search_tokens);
+      }
+      break;
+    case FIELD_METADATA_LICENSE:
+      priv->metadata_license = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_PROJECT_LICENSE:
+      priv->project_license = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_IS_FLOSS:
+      priv->is_floss = g_variant_get_boolean (value);
+      break;
+    case FIELD_PROJECT_GROUP:
+      priv->project_group = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_DEVELOPER:
+      priv->developer = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_DEVELOPER_ID:
+      priv->developer_id = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_SCREENSHOT_PAINTABLES:
+      {
+        g_autoptr (GListStore) store             = NULL;
+        g_autoptr (GVariantIter) screenshot_iter = NULL;
+
+        store = g_list_store_new (BZ_TYPE_ASYNC_TEXTURE);
+
+        screenshot_iter = g_variant_iter_new (value);
+        for (;;)
+          {
+            g_autofree char *basename        = NULL;
+            g_autoptr (GVariant) screenshot  = NULL;
+            g_autoptr (GdkPaintable) texture = NULL;
+
+            if (!g_variant_iter_next (screenshot_iter, "{sv}", &basename, &screenshot))
+              break;
+            texture = make_async_texture (screenshot);
+            g_list_store_append (store, texture);
+          }
+
+        priv->screenshot_paintables = G_LIST_MODEL (g_steal_pointer (&store));
+      }
+      break;
+    case FIELD_SHARE_URLS:
+      priv->deferred_share_urls = g_variant_ref (value);
+      break;
+    case FIELD_DONATION_URL:
+      priv->donation_url = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_FORGE_URL:
+      priv->forge_url = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_VERSION_HISTORY:
+      priv->deferred_version_history = g_variant_ref (value);
+      break;
+    case FIELD_LIGHT_ACCENT_COLOR:
+      priv->light_accent_color = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_DARK_ACCENT_COLOR:
+      priv->dark_accent_color = g_variant_dup_string (value, NULL);
+      break;
+    case FIELD_IS_MOBILE_FRIENDLY:
+      priv->is_mobile_friendly = g_variant_get_boolean (value);
+      break;
+    case FIELD_REQUIRED_CONTROLS:
+      priv->required_controls = g_variant_get_uint32 (value);
+      break;
+    case FIELD_RECOMMENDED_CONTROLS:
+      priv->recommended_controls = g_variant_get_uint32 (value);
+      break;
+    case FIELD_SUPPORTED_CONTROLS:
+      priv->supported_controls = g_variant_get_uint32 (value);
+      break;
+    case FIELD_MIN_DISPLAY_LENGTH:
+      priv->min_display_length = g_variant_get_int32 (value);
+      break;
+    case FIELD_MAX_DISPLAY_LENGTH:
+      priv->max_display_length = g_variant_get_int32 (value);
+      break;
+    case FIELD_AGE_RATING:
+      priv->age_rating = g_variant_get_int32 (value);
+      break;
+    case FIELD_IS_FLATHUB:
+      priv->is_flathub = g_variant_get_boolean (value);
+      break;
+
+    /* Disabling these since it updates so often and downloading is cheap */
+    case FIELD_VERIFIED:
+    case FIELD_DOWNLOAD_STATS:
+    case FIELD_RECENT_DOWNLOADS:
+      break;
+
+    case N_FIELDS:
+    default:
+      g_assert_not_reached ();
     }
-  if (priv->share_urls != NULL)
+}
+
+/* Maps field keys to their index plus one */
+static GHashTable *
+get_field_indices (void)
+{
+  static GHashTable *indices = NULL;
+
+  if (g_once_init_enter_pointer (&indices))
     {
-      guint n_items = 0;
+      GHashTable *table = NULL;
 
-      n_items = g_list_model_get_n_items (priv->share_urls);
-      if (n_items > 0)
-        {
-          g_autoptr (GVariantBuilder) sub_builder = NULL;
+      table = g_hash_table_new (g_str_hash, g_str_equal);
+      for (guint i = 0; i < N_FIELDS; i++)
+        g_hash_table_replace (table, (gpointer) fields[i].key, GUINT_TO_POINTER (i + 1));
 
-          sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sss)"));
-          for (guint i = 0; i < n_items; i++)
-            {
-              g_autoptr (BzUrl) url = NULL;
-              const char *name      = NULL;
-              const char *url_str   = NULL;
-              const char *icon_name = NULL;
-
-              url       = g_list_model_get_item (priv->share_urls, i);
-              name      = bz_url_get_name (url);
-              url_str   = bz_url_get_url (url);
-              icon_name = bz_url_get_icon_name (url);
-              g_variant_builder_add (sub_builder, "(sss)", name, url_str, icon_name ? icon_name : "");
-            }
-          g_variant_builder_add (builder, "{sv}", "share-urls", g_variant_builder_end (sub_builder));
-        }
+      g_once_init_leave_pointer (&indices, table);
     }
-  if (priv->donation_url != NULL)
-    g_variant_builder_add (builder, "{sv}", "donation-url", g_variant_new_string (priv->donation_url));
-  if (priv->forge_url != NULL)
-    g_variant_builder_add (builder, "{sv}", "forge-url", g_variant_new_string (priv->forge_url));
-  if (priv->version_history != NULL)
-    {
-      guint n_items = 0;
 
-      n_items = g_list_model_get_n_items (priv->version_history);
-      if (n_items > 0)
-        {
-          g_autoptr (GVariantBuilder) sub_builder = NULL;
+  return indices;
+}
 
-          sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(msmvtmsms)"));
-          for (guint i = 0; i < n_items; i++)
-            {
-              g_autoptr (BzRelease) release              = NULL;
-              GListModel *issues                         = NULL;
-              g_autoptr (GVariantBuilder) issues_builder = NULL;
-              guint       n_issues                       = 0;
-              guint64     timestamp                      = 0;
-              const char *url                            = NULL;
-              const char *version                        = NULL;
-              const char *description                    = NULL;
-
-              release     = g_list_model_get_item (priv->version_history, i);
-              issues      = bz_release_get_issues (release);
-              timestamp   = bz_release_get_timestamp (release);
-              url         = bz_release_get_url (release);
-              version     = bz_release_get_version (release);
-              description = bz_release_get_description (release);
-
-              if (issues != NULL)
-                {
-                  n_issues = g_list_model_get_n_items (issues);
-                  if (n_issues > 0)
-                    {
-                      issues_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(msms)"));
-                      for (guint j = 0; j < n_issues; j++)
-                        {
-                          g_autoptr (BzIssue) issue = NULL;
-                          const char *issue_id      = NULL;
-                          const char *issue_url     = NULL;
-
-                          issue     = g_list_model_get_item (issues, j);
-                          issue_id  = bz_issue_get_id (issue);
-                          issue_url = bz_issue_get_url (issue);
-
-                          g_variant_builder_add (issues_builder, "(msms)", issue_id, issue_url);
-                        }
-                    }
-                }
-
-              g_variant_builder_add (
-                  sub_builder,
-                  "(msmvtmsms)",
-                  description,
-                  issues_builder != NULL
-                      ? g_variant_builder_end (issues_builder)
-                      : NULL,
-                  timestamp,
-                  url,
-                  version);
-            }
+static void
+bz_entry_real_serialize (BzSerializable  *serializable,
+                         GVariantBuilder *builder)
+{
+  BzEntry        *self = BZ_ENTRY (serializable);
+  BzEntryPrivate *priv = bz_entry_get_instance_private (self);
 
-          g_variant_builder_add (builder, "{sv}", "version-history", g_variant_builder_end (sub_builder));
-        }
-    }
-  if (priv->light_accent_color != NULL)
-    g_variant_builder_add (builder, "{sv}", "light-accent-color", g_variant_new_string (priv->light_accent_color));
-  if (priv->dark_accent_color != NULL)
-    g_variant_builder_add (builder, "{sv}", "dark-accent-color", g_variant_new_string (priv->dark_accent_color));
-  g_variant_builder_add (builder, "{sv}", "is-mobile-friendly", g_variant_new_boolean (priv->is_mobile_friendly));
-  if (priv->required_controls != BZ_CONTROL_NONE)
-    g_variant_builder_add (builder, "{sv}", "required-controls", g_variant_new_uint32 (priv->required_controls));
-  if (priv->recommended_controls != BZ_CONTROL_NONE)
-    g_variant_builder_add (builder, "{sv}", "recommended-controls", g_variant_new_uint32 (priv->recommended_controls));
-  if (priv->supported_controls != BZ_CONTROL_NONE)
-    g_variant_builder_add (builder, "{sv}", "supported-controls", g_variant_new_uint32 (priv->supported_controls));
-  if (priv->min_display_length > 0)
-    g_variant_builder_add (builder, "{sv}", "min-display-length", g_variant_new_int32 (priv->min_display_length));
-  if (priv->max_display_length > 0)
-    g_variant_builder_add (builder, "{sv}", "max-display-length", g_variant_new_int32 (priv->max_display_length));
-  g_variant_builder_add (builder, "{sv}", "age-rating", g_variant_new_int32 (priv->age_rating));
-  g_variant_builder_add (builder, "{sv}", "is-flathub", g_variant_new_boolean (priv->is_flathub));
-  if (priv->is_flathub)
+  for (guint i = 0; i < N_FIELDS; i++)
     {
-      if (priv->flathub_prop_queries != NULL)
-        {
-          if (g_hash_table_contains (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_VERIFIED)))
-            g_variant_builder_add (builder, "{sv}", "verified", g_variant_new_boolean (priv->verified));
-          if (g_hash_table_contains (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_DOWNLOAD_STATS)) &&
-              priv->download_stats != NULL)
-            {
-              guint n_items = 0;
-
-              n_items = g_list_model_get_n_items (priv->download_stats);
-              if (n_items > 0)
-                {
-                  g_autoptr (GVariantBuilder) sub_builder = NULL;
-
-                  sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(ddms)"));
-                  for (guint i = 0; i < n_items; i++)
-                    {
-                      g_autoptr (BzDataPoint) point = NULL;
-                      double      independent       = 0.0;
-                      double      dependent         = 0.0;
-                      const char *label             = NULL;
-
-                      point       = g_list_model_get_item (priv->download_stats, i);
-                      independent = bz_data_point_get_independent (point);
-                      dependent   = bz_data_point_get_dependent (point);
-                      label       = bz_data_point_get_label (point);
-
-                      g_variant_builder_add (sub_builder, "(ddms)", independent, dependent, label);
-                    }
-                  g_variant_builder_add (builder, "{sv}", "download-stats", g_variant_builder_end (sub_builder));
-                }
-            }
-          if (g_hash_table_contains (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_RECENT_DOWNLOADS)))
-            g_variant_builder_add (builder, "{sv}", "recent-downloads", g_variant_new_int32 (priv->recent_downloads));
-        }
+      g_autoptr (GVariant) value = NULL;
+
+      value = serialize_field (priv, i);
+      if (value == NULL)
+        continue;
+
+      g_variant_take_ref (value);
+      g_variant_builder_add (builder, "{sv}", fields[i].key, value);
     }
 }
 
@@ -1238,271 +1623,32 @@ bz_entry_real_deserialize (BzSerializable *serializable,
 {
   BzEntry        *self          = BZ_ENTRY (serializable);
   BzEntryPrivate *priv          = bz_entry_get_instance_private (self);
+  GHashTable     *indices       = NULL;
   g_autoptr (GVariantIter) iter = NULL;
 
   clear_entry (self);
 
-  iter = g_variant_iter_new (import);
+  indices = get_field_indices ();
+  iter    = g_variant_iter_new (import);
   for (;;)
     {
-      g_autofree char *key       = NULL;
+      const char *key            = NULL;
       g_autoptr (GVariant) value = NULL;
+      guint index                = 0;
 
-      if (!g_variant_iter_next (iter, "{sv}", &key, &value))
+      if (!g_variant_iter_next (iter, "{&sv}", &key, &value))
         break;
 
-      if (g_strcmp0 (key, "installed") == 0)
-        priv->installed = g_variant_get_boolean (value);
-      else if (g_strcmp0 (key, "kinds") == 0)
-        priv->kinds = g_variant_get_uint32 (value);
-      else if (g_strcmp0 (key, "addons") == 0)
-        {
-          g_autoptr (GListStore) store        = NULL;
-          g_autoptr (GVariantIter) addon_iter = NULL;
-
-          store = g_list_store_new (GTK_TYPE_STRING_OBJECT);
-
-          addon_iter = g_variant_iter_new (value);
-          for (;;)
-            {
-              g_autofree char *unique_id         = NULL;
-              g_autoptr (GtkStringObject) string = NULL;
-
-              if (!g_variant_iter_next (addon_iter, "s", &unique_id))
-                break;
-              string = gtk_string_object_new (unique_id);
-              g_list_store_append (store, string);
-            }
-
-          priv->addons = G_LIST_MODEL (g_steal_pointer (&store));
-        }
-      else if (g_strcmp0 (key, "id") == 0)
-        priv->id = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "unique-id") == 0)
-        priv->unique_id = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "unique-id-checksum") == 0)
-        priv->unique_id_checksum = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "title") == 0)
-        priv->title = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "eol") == 0)
-        priv->eol = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "description") == 0)
-        priv->description = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "long-description") == 0)
-        priv->long_description = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "remote-repo-name") == 0)
-        priv->remote_repo_name = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "url") == 0)
-        priv->url = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "size") == 0)
-        priv->size = g_variant_get_uint64 (value);
-      else if (g_strcmp0 (key, "icon-paintable") == 0)
-        priv->icon_paintable = make_async_texture (value);
-      else if (g_strcmp0 (key, "mini-icon") == 0)
-        priv->mini_icon = g_icon_deserialize (value);
-      else if (g_strcmp0 (key, "remote-repo-icon") == 0)
-        priv->remote_repo_icon = make_async_texture (value);
-      else if (g_strcmp0 (key, "search-tokens") == 0)
-        {
-          g_autoptr (GPtrArray) search_tokens = NULL;
-          g_autoptr (GVariantIter) token_iter = NULL;
-
-          search_tokens = g_ptr_array_new_with_free_func (g_free);
-
-          token_iter = g_variant_iter_new (value);
-          for (;;)
-            {
-              g_autofree char *token = NULL;
-
-              if (!g_variant_iter_next (token_iter, "s", &token))
-                break;
-              g_ptr_array_add (search_tokens, g_steal_pointer (&token));
-            }
-          priv->search_tokens = g_steal_pointer (&search_tokens);
-        }
-      else if (g_strcmp0 (key, "metadata-license") == 0)
-        priv->metadata_license = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "project-license") == 0)
-        priv->project_license = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "is-floss") == 0)
-        priv->is_floss = g_variant_get_boolean (value);
-      else if (g_strcmp0 (key, "developer") == 0)
-        priv->developer = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "developer-id") == 0)
-        priv->developer_id = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "screenshot-paintables") == 0)
-        {
-          g_autoptr (GListStore) store             = NULL;
-          g_autoptr (GVariantIter) screenshot_iter = NULL;
-
-          store = g_list_store_new (BZ_TYPE_ASYNC_TEXTURE);
-
-          screenshot_iter = g_variant_iter_new (value);
-          for (;;)
-            {
-              g_autofree char *basename        = NULL;
-              g_autoptr (GVariant) screenshot  = NULL;
-              g_autoptr (GdkPaintable) texture = NULL;
-
-              if (!g_variant_iter_next (screenshot_iter, "{sv}", &basename, &screenshot))
-                break;
-              texture = make_async_texture (screenshot);
-              g_list_store_append (store, texture);
-            }
-
-          priv->screenshot_paintables = G_LIST_MODEL (g_steal_pointer (&store));
-        }
-      else if (g_strcmp0 (key, "share-urls") == 0)
-        {
-          g_autoptr (GListStore) store      = NULL;
-          g_autoptr (GVariantIter) url_iter = NULL;
-
-          store = g_list_store_new (BZ_TYPE_URL);
-
-          url_iter = g_variant_iter_new (value);
-          for (;;)
-            {
-              g_autofree char *name      = NULL;
-              g_autofree char *url_str   = NULL;
-              g_autoptr (BzUrl) url      = NULL;
-              g_autofree char *icon_name = NULL;
-
-              if (!g_variant_iter_next (url_iter, "(sss)", &name, &url_str, &icon_name))
-                break;
-              url = bz_url_new ();
-              bz_url_set_name (url, name);
-              bz_url_set_url (url, url_str);
-              bz_url_set_icon_name (url, icon_name);
-              g_list_store_append (store, url);
-            }
-
-          priv->share_urls = G_LIST_MODEL (g_steal_pointer (&store));
-        }
-      else if (g_strcmp0 (key, "donation-url") == 0)
-        priv->donation_url = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "forge-url") == 0)
-        priv->forge_url = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "version-history") == 0)
-        {
-          g_autoptr (GListStore) store          = NULL;
-          g_autoptr (GVariantIter) version_iter = NULL;
+      /* Subclasses store their keys alongside ours */
+      index = GPOINTER_TO_UINT (g_hash_table_lookup (indices, key));
+      if (index == 0)
+        continue;
 
-          store = g_list_store_new (BZ_TYPE_RELEASE);
+      if (g_strcmp0 (fields[index - 1].type, "v") != 0 &&
+          !g_variant_is_of_type (value, G_VARIANT_TYPE (fields[index - 1].type)))
+        continue;
 
-          version_iter = g_variant_iter_new (value);
-          for (;;)
-            {
-              g_autoptr (GVariant) issues         = NULL;
-              g_autoptr (GListStore) issues_store = NULL;
-              guint64          timestamp          = 0;
-              g_autofree char *url                = NULL;
-              g_autofree char *description        = NULL;
-              g_autofree char *version            = NULL;
-              g_autoptr (BzRelease) release       = NULL;
-
-              if (!g_variant_iter_next (version_iter, "(msmvtmsms)", &description, &issues, &timestamp, &url, &version))
-                break;
-
-              if (issues != NULL)
-                {
-                  g_autoptr (GVariantIter) issues_iter = NULL;
-
-                  issues_store = g_list_store_new (BZ_TYPE_ISSUE);
-
-                  issues_iter = g_variant_iter_new (issues);
-                  for (;;)
-                    {
-                      g_autofree char *issue_id  = NULL;
-                      g_autofree char *issue_url = NULL;
-                      g_autoptr (BzIssue) issue  = NULL;
-
-                      if (!g_variant_iter_next (issues_iter, "(msms)", &issue_id, &issue_url))
-                        break;
-
-                      issue = bz_issue_new ();
-                      bz_issue_set_id (issue, issue_id);
-                      bz_issue_set_url (issue, issue_url);
-                      g_list_store_append (issues_store, issue);
-                    }
-                }
-
-              release = bz_release_new ();
-              if (issues_store != NULL)
-                bz_release_set_issues (release, G_LIST_MODEL (issues_store));
-              bz_release_set_timestamp (release, timestamp);
-              bz_release_set_url (release, url);
-              bz_release_set_version (release, version);
-              bz_release_set_description (release, description);
-              g_list_store_append (store, release);
-            }
-
-          priv->version_history = G_LIST_MODEL (g_steal_pointer (&store));
-        }
-      else if (g_strcmp0 (key, "light-accent-color") == 0)
-        priv->light_accent_color = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "dark-accent-color") == 0)
-        priv->dark_accent_color = g_variant_dup_string (value, NULL);
-      else if (g_strcmp0 (key, "is-mobile-friendly") == 0)
-        priv->is_mobile_friendly = g_variant_get_boolean (value);
-      else if (g_strcmp0 (key, "required-controls") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
-        priv->required_controls = g_variant_get_uint32 (value);
-      else if (g_strcmp0 (key, "recommended-controls") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
-        priv->recommended_controls = g_variant_get_uint32 (value);
-      else if (g_strcmp0 (key, "supported-controls") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
-        priv->supported_controls = g_variant_get_uint32 (value);
-      else if (g_strcmp0 (key, "min-display-length") == 0)
-        priv->min_display_length = g_variant_get_int32 (value);
-      else if (g_strcmp0 (key, "max-display-length") == 0)
-        priv->max_display_length = g_variant_get_int32 (value);
-      else if (g_strcmp0 (key, "age-rating") == 0)
-        priv->age_rating = g_variant_get_int32 (value);
-      else if (g_strcmp0 (key, "is-flathub") == 0)
-        priv->is_flathub = g_variant_get_boolean (value);
-
-      /* Disabling these since it updates so often and downloading is cheap */
-      // else if (g_strcmp0 (key, "verified") == 0)
-      //   {
-      //     priv->verified = g_variant_get_boolean (value);
-      //     if (priv->flathub_prop_queries == NULL)
-      //       priv->flathub_prop_queries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, dex_unref);
-      //     g_hash_table_replace (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_VERIFIED), dex_future_new_true ());
-      //   }
-      // else if (g_strcmp0 (key, "download-stats") == 0)
-      //   {
-      //     g_autoptr (GListStore) store        = NULL;
-      //     g_autoptr (GVariantIter) point_iter = NULL;
-
-      //     store = g_list_store_new (BZ_TYPE_DATA_POINT);
-
-      //     point_iter = g_variant_iter_new (value);
-      //     for (;;)
-      //       {
-      //         double           independent  = 0.0;
-      //         double           dependent    = 0.0;
-      //         g_autofree char *label        = NULL;
-      //         g_autoptr (BzDataPoint) point = NULL;
-
-      //         if (!g_variant_iter_next (point_iter, "(ddms)", &independent, &dependent, &label))
-      //           break;
-      //         point = bz_data_point_new ();
-      //         bz_data_point_set_independent (point, independent);
-      //         bz_data_point_set_dependent (point, dependent);
-      //         bz_data_point_set_label (point, label);
-      //         g_list_store_append (store, point);
-      //       }
-
-      //     priv->download_stats = G_LIST_MODEL (g_steal_pointer (&store));
-      //     if (priv->flathub_prop_queries == NULL)
-      //       priv->flathub_prop_queries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, dex_unref);
-      //     g_hash_table_replace (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_DOWNLOAD_STATS), dex_future_new_true ());
-      //   }
-      // else if (g_strcmp0 (key, "recent-downloads") == 0)
-      //   {
-      //     priv->recent_downloads = g_variant_get_int32 (value);
-      //     if (priv->flathub_prop_queries == NULL)
-      //       priv->flathub_prop_queries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, dex_unref);
-      //     g_hash_table_replace (priv->flathub_prop_queries, GINT_TO_POINTER (PROP_RECENT_DOWNLOADS), dex_future_new_true ());
-      //   }
+      deserialize_field (priv, index - 1, value);
     }
 
   return TRUE;
@@ -1564,6 +1710,7 @@ bz_entry_set_installed (BzEntry *self,
   priv = bz_entry_get_instance_private (self);
 
   priv->installed = installed;
+  g_atomic_int_inc (&priv->generation);
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_INSTALLED]);
 }
 
@@ -1590,6 +1737,8 @@ bz_entry_append_addon (BzEntry    *self,
   g_return_if_fail (id != NULL);
   priv = bz_entry_get_instance_private (self);
 
+  g_atomic_int_inc (&priv->generation);
+
   string = gtk_string_object_new (id);
   if (priv->addons == NULL)
     {
@@ -1774,6 +1923,7 @@ bz_entry_get_share_urls (BzEntry *self)
   g_return_val_if_fail (BZ_IS_ENTRY (self), NULL);
   priv = bz_entry_get_instance_private (self);
 
+  ensure_share_urls (priv);
   return priv->share_urls;
 }
 
@@ -2024,13 +2174,24 @@ bz_entry_calc_usefulness (BzEntry *self)
   score += priv->developer != NULL ? 1 : 0;
   score += priv->developer_id != NULL ? 1 : 0;
   score += priv->screenshot_paintables != NULL ? 5 : 0;
-  score += priv->share_urls != NULL ? 5 : 0;
+  score += priv->share_urls != NULL || priv->deferred_share_urls != NULL ? 5 : 0;
 
   score -= priv->eol != NULL ? 500 : 0;
 
   return score;
 }
 
+guint
+bz_entry_get_generation (BzEntry *self)
+{
+  BzEntryPrivate *priv = NULL;
+
+  g_return_val_if_fail (BZ_IS_ENTRY (self), 0);
+  priv = bz_entry_get_instance_private (self);
+
+  return g_atomic_int_get (&priv->generation);
+}
+
 void
 bz_entry_serialize (BzEntry         *self,
                     GVariantBuilder *builder)
@@ -2052,6 +2213,118 @@ bz_entry_deserialize (BzEntry  *self,
   return bz_entry_real_deserialize (BZ_SERIALIZABLE (self), import, error);
 }
 
+const GVariantType *
+bz_entry_get_compact_type (void)
+{
+  static GVariantType *type = NULL;
+
+  if (g_once_init_enter_pointer (&type))
+    {
+      g_autoptr (GString) string = NULL;
+
+      string = g_string_new ("(q");
+      for (guint i = 0; i < N_FIELDS; i++)
+        g_string_append_printf (string, "m%s", fields[i].type);
+      g_string_append_c (string, ')');
+
+      g_once_init_leave_pointer (&type, g_variant_type_new (string->str));
+    }
+
+  return type;
+}
+
+GVariant *
+bz_entry_serialize_compact (BzEntry *self)
+{
+  BzEntryPrivate *priv           = NULL;
+  g_autofree GVariant **children = NULL;
+
+  g_return_val_if_fail (BZ_IS_ENTRY (self), NULL);
+  priv = bz_entry_get_instance_private (self);
+
+  children    = g_new0 (GVariant *, N_FIELDS + 1);
+  children[0] = g_variant_new_uint16 (COMPACT_VERSION);
+  for (guint i = 0; i < N_FIELDS; i++)
+    {
+      g_autoptr (GVariant) value = NULL;
+
+      value = serialize_field (priv, i);
+      if (value != NULL)
+        {
+          g_variant_take_ref (value);
+          if (g_strcmp0 (fields[i].type, "v") == 0)
+            children[i + 1] = g_variant_new_maybe (NULL, g_variant_new_variant (value));
+          else
+            children[i + 1] = g_variant_new_maybe (NULL, value);
+        }
+      else
+        children[i + 1] = g_variant_new_maybe (G_VARIANT_TYPE (fields[i].type), NULL);
+    }
+
+  return g_variant_new_tuple (children, N_FIELDS + 1);
+}
+
+gboolean
+bz_entry_deserialize_compact (BzEntry  *self,
+                              GVariant *import,
+                              GError  **error)
+{
+  BzEntryPrivate *priv = NULL;
+  guint16 version      = 0;
+
+  g_return_val_if_fail (BZ_IS_ENTRY (self), FALSE);
+  g_return_val_if_fail (import != NULL, FALSE);
+  priv = bz_entry_get_instance_private (self);
+
+  if (!g_variant_is_of_type (import, bz_entry_get_compact_type ()))
+    {
+      g_set_error (
+          error,
+          G_IO_ERROR,
+          G_IO_ERROR_INVALID_DATA,
+          "Compact entry has unexpected type %s",
+          g_variant_get_type_string (import));
+      return FALSE;
+    }
+
+  g_variant_get_child (import, 0, "q", &version);
+  if (version != COMPACT_VERSION)
+    {
+      g_set_error (
+          error,
+          G_IO_ERROR,
+          G_IO_ERROR_INVALID_DATA,
+          "Compact entry has version %u, expected %u",
+          version, COMPACT_VERSION);
+      return FALSE;
+    }
+
+  clear_entry (self);
+
+  for (guint i = 0; i < N_FIELDS; i++)
+    {
+      g_autoptr (GVariant) maybe = NULL;
+      g_autoptr (GVariant) value = NULL;
+
+      maybe = g_variant_get_child_value (import, i + 1);
+      value = g_variant_get_maybe (maybe);
+      if (value == NULL)
+        continue;
+
+      if (g_strcmp0 (fields[i].type, "v") == 0)
+        {
+          g_autoptr (GVariant) boxed = NULL;
+
+          boxed = g_steal_pointer (&value);
+          value = g_variant_get_variant (boxed);
+        }
+
+      deserialize_field (priv, i, value);
+    }
+
+  return TRUE;
+}
+
 static void
 query_flathub (BzEntry *self,
                int      prop)
@@ -2283,11 +2556,8 @@ download_stats_per_country_foreach (JsonObject  *object,
   g_list_store_append (store, point);
 }
 
-static gboolean
-maybe_save_paintable (BzEntryPrivate  *priv,
-                      const char      *key,
-                      GdkPaintable    *paintable,
-                      GVariantBuilder *builder)
+static GVariant *
+save_paintable (GdkPaintable *paintable)
 {
   g_autoptr (GError) local_error = NULL;
   const char *source_uri         = NULL;
@@ -2299,7 +2569,7 @@ maybe_save_paintable (BzEntryPrivate  *priv,
   if (!BZ_IS_ASYNC_TEXTURE (paintable))
     {
       g_warning ("Paintable must be of type BzAsyncTexture to be serialized!");
-      return FALSE;
+      return NULL;
     }
 
   source_uri      = bz_async_texture_get_source_uri (BZ_ASYNC_TEXTURE (paintable));
@@ -2372,8 +2642,7 @@ maybe_save_paintable (BzEntryPrivate  *priv,
     }
 
 done:
-  g_variant_builder_add (builder, "{sv}", key, g_variant_new ("(sms)", source_uri, cache_into_path));
-  return TRUE;
+  return g_variant_new ("(sms)", source_uri, cache_into_path);
 }
 
 static GdkPaintable *
@@ -2510,6 +2779,111 @@ load_mini_icon_notify (LoadMiniIconData *data)
   return dex_future_new_true ();
 }
 
+static GListModel *
+share_urls_from_variant (GVariant *value)
+{
+  g_autoptr (GListStore) store      = NULL;
+  g_autoptr (GVariantIter) url_iter = NULL;
+
+  store = g_list_store_new (BZ_TYPE_URL);
+
+  url_iter = g_variant_iter_new (value);
+  for (;;)
+    {
+      g_autofree char *name      = NULL;
+      g_autofree char *url_str   = NULL;
+      g_autoptr (BzUrl) url      = NULL;
+      g_autofree char *icon_name = NULL;
+
+      if (!g_variant_iter_next (url_iter, "(sss)", &name, &url_str, &icon_name))
+        break;
+      url = bz_url_new ();
+      bz_url_set_name (url, name);
+      bz_url_set_url (url, url_str);
+      bz_url_set_icon_name (url, icon_name);
+      g_list_store_append (store, url);
+    }
+
+  return G_LIST_MODEL (g_steal_pointer (&store));
+}
+
+static GListModel *
+version_history_from_variant (GVariant *value)
+{
+  g_autoptr (GListStore) store          = NULL;
+  g_autoptr (GVariantIter) version_iter = NULL;
+
+  store = g_list_store_new (BZ_TYPE_RELEASE);
+
+  version_iter = g_variant_iter_new (value);
+  for (;;)
+    {
+      g_autoptr (GVariant) issues         = NULL;
+      g_autoptr (GListStore) issues_store = NULL;
+      guint64          timestamp          = 0;
+      g_autofree char *url                = NULL;
+      g_autofree char *description        = NULL;
+      g_autofree char *version            = NULL;
+      g_autoptr (BzRelease) release       = NULL;
+
+      if (!g_variant_iter_next (version_iter, "(msmvtmsms)", &description, &issues, &timestamp, &url, &version))
+        break;
+
+      if (issues != NULL)
+        {
+          g_autoptr (GVariantIter) issues_iter = NULL;
+
+          issues_store = g_list_store_new (BZ_TYPE_ISSUE);
+
+          issues_iter = g_variant_iter_new (issues);
+          for (;;)
+            {
+              g_autofree char *issue_id  = NULL;
+              g_autofree char *issue_url = NULL;
+              g_autoptr (BzIssue) issue  = NULL;
+
+              if (!g_variant_iter_next (issues_iter, "(msms)", &issue_id, &issue_url))
+                break;
+
+              issue = bz_issue_new ();
+              bz_issue_set_id (issue, issue_id);
+              bz_issue_set_url (issue, issue_url);
+              g_list_store_append (issues_store, issue);
+            }
+        }
+
+      release = bz_release_new ();
+      if (issues_store != NULL)
+        bz_release_set_issues (release, G_LIST_MODEL (issues_store));
+      bz_release_set_timestamp (release, timestamp);
+      bz_release_set_url (release, url);
+      bz_release_set_version (release, version);
+      bz_release_set_description (release, description);
+      g_list_store_append (store, release);
+    }
+
+  return G_LIST_MODEL (g_steal_pointer (&store));
+}
+
+/* The variant stays around after this, since the cache
+ * may be serializing the entry from another thread
+ */
+static void
+ensure_share_urls (BzEntryPrivate *priv)
+{
+  if (priv->share_urls == NULL &&
+      priv->deferred_share_urls != NULL)
+    priv->share_urls = share_urls_from_variant (priv->deferred_share_urls);
+}
+
+static void
+ensure_version_history (BzEntryPrivate *priv)
+{
+  if (priv->version_history == NULL &&
+      priv->deferred_version_history != NULL)
+    priv->version_history = version_history_from_variant (priv->deferred_version_history);
+}
+
 static void
 clear_entry (BzEntry *self)
 {
@@ -2539,11 +2913,13 @@ clear_entry (BzEntry *self)
   g_clear_object (&priv->developer_apps);
   g_clear_object (&priv->screenshot_paintables);
   g_clear_object (&priv->share_urls);
+  g_clear_pointer (&priv->deferred_share_urls, g_variant_unref);
   g_clear_pointer (&priv->donation_url, g_free);
   g_clear_pointer (&priv->forge_url, g_free);
   g_clear_object (&priv->reviews);
   g_clear_pointer (&priv->ratings_summary, g_free);
   g_clear_object (&priv->version_history);
+  g_clear_pointer (&priv->deferred_version_history, g_variant_unref);
   g_clear_pointer (&priv->light_accent_color, g_free);
   g_clear_pointer (&priv->dark_accent_color, g_free);
   g_clear_object (&priv->download_stats);
@@ -203,6 +203,9 @@ bz_entry_load_mini_icon (BzEntry *self);
 gint
 bz_entry_calc_usefulness (BzEntry *self);
 
+guint
+bz_entry_get_generation (BzEntry *self);
+
 void
 bz_entry_serialize (BzEntry         *self,
                     GVariantBuilder *builder);
@@ -212,6 +215,17 @@ bz_entry_deserialize (BzEntry  *self,
                       GVariant *import,
                       GError  **error);
 
+const GVariantType *
+bz_entry_get_compact_type (void);
+
+GVariant *
+bz_entry_serialize_compact (BzEntry *self);
+
+gboolean
+bz_entry_deserialize_compact (BzEntry  *self,
+                              GVariant *import,
+                              GError  **error);
+
 GIcon *
 bz_load_mini_icon_sync (const char *unique_id_checksum,
                         const char *path);
@@ -58,6 +58,7 @@ struct _BzFlatpakEntry
   char    *application_command;
   char    *runtime_name;
   char    *addon_extension_of_ref;
+  char    *cache_validator;
 
   FlatpakRef *ref;
 };
@@ -261,6 +262,8 @@ bz_flatpak_entry_real_serialize (BzSerializable  *serializable,
     g_variant_builder_add (builder, "{sv}", "runtime-name", g_variant_new_string (self->runtime_name));
   if (self->addon_extension_of_ref != NULL)
     g_variant_builder_add (builder, "{sv}", "addon-extension-of-ref", g_variant_new_string (self->addon_extension_of_ref));
+  if (self->cache_validator != NULL)
+    g_variant_builder_add (builder, "{sv}", "cache-validator", g_variant_new_string (self->cache_validator));
 
   bz_entry_serialize (BZ_ENTRY (self), builder);
 }
@@ -278,10 +281,10 @@ bz_flatpak_entry_real_deserialize (BzSerializable *serializable,
   iter = g_variant_iter_new (import);
   for (;;)
     {
-      g_autofree char *key       = NULL;
+      const char *key            = NULL;
       g_autoptr (GVariant) value = NULL;
 
-      if (!g_variant_iter_next (iter, "{sv}", &key, &value))
+      if (!g_variant_iter_next (iter, "{&sv}", &key, &value))
         break;
 
       if (g_strcmp0 (key, "user") == 0)
@@ -302,16 +305,117 @@ bz_flatpak_entry_real_deserialize (BzSerializable *serializable,
         self->runtime_name = g_variant_dup_string (value, NULL);
       else if (g_strcmp0 (key, "addon-extension-of-ref") == 0)
         self->addon_extension_of_ref = g_variant_dup_string (value, NULL);
+      else if (g_strcmp0 (key, "cache-validator") == 0)
+        self->cache_validator = g_variant_dup_string (value, NULL);
     }
 
   return bz_entry_deserialize (BZ_ENTRY (self), import, error);
 }
 
+#define COMPACT_VERSION 1
+#define COMPACT_FIELDS  "(bmsmsmsmsmsmsmsmsms)"
+
+static const GVariantType *
+bz_flatpak_entry_real_get_compact_type (BzSerializable *serializable)
+{
+  static GVariantType *type = NULL;
+
+  if (g_once_init_enter_pointer (&type))
+    {
+      g_autofree char *string = NULL;
+
+      string = g_strdup_printf (
+          "(q" COMPACT_FIELDS "%.*s)",
+          (int) g_variant_type_get_string_length (bz_entry_get_compact_type ()),
+          g_variant_type_peek_string (bz_entry_get_compact_type ()));
+      g_once_init_leave_pointer (&type, g_variant_type_new (string));
+    }
+
+  return type;
+}
+
+static GVariant *
+bz_flatpak_entry_real_serialize_compact (BzSerializable *serializable)
+{
+  BzFlatpakEntry *self = BZ_FLATPAK_ENTRY (serializable);
+
+  return g_variant_new (
+      "(q" COMPACT_FIELDS "@*)",
+      COMPACT_VERSION,
+      self->user,
+      self->flatpak_name,
+      self->flatpak_id,
+      self->flatpak_version,
+      self->application_name,
+      self->application_runtime,
+      self->application_command,
+      self->runtime_name,
+      self->addon_extension_of_ref,
+      self->cache_validator,
+      bz_entry_serialize_compact (BZ_ENTRY (self)));
+}
+
+static gboolean
+bz_flatpak_entry_real_deserialize_compact (BzSerializable *serializable,
+                                           GVariant       *import,
+                                           GError        **error)
+{
+  BzFlatpakEntry *self        = BZ_FLATPAK_ENTRY (serializable);
+  guint16 version             = 0;
+  g_autoptr (GVariant) parent = NULL;
+
+  if (!g_variant_is_of_type (import, bz_flatpak_entry_real_get_compact_type (serializable)))
+    {
+      g_set_error (
+          error,
+          G_IO_ERROR,
+          G_IO_ERROR_INVALID_DATA,
+          "Compact flatpak entry has unexpected type %s",
+          g_variant_get_type_string (import));
+      return FALSE;
+    }
+
+  g_variant_get_child (import, 0, "q", &version);
+  if (version != COMPACT_VERSION)
+    {
+      g_set_error (
+          error,
+          G_IO_ERROR,
+          G_IO_ERROR_INVALID_DATA,
+          "Compact flatpak entry has version %u, expected %u",
+          version, COMPACT_VERSION);
+      return FALSE;
+    }
+
+  clear_entry (self);
+
+  g_variant_get (
+      import,
+      "(q" COMPACT_FIELDS "@*)",
+      NULL,
+      &self->user,
+      &self->flatpak_name,
+      &self->flatpak_id,
+      &self->flatpak_version,
+      &self->application_name,
+      &self->application_runtime,
+      &self->application_command,
+      &self->runtime_name,
+      &self->addon_extension_of_ref,
+      &self->cache_validator,
+      &parent);
+
+  return bz_entry_deserialize_compact (BZ_ENTRY (self), parent, error);
+}
+
 static void
 serializable_iface_init (BzSerializableInterface *iface)
 {
-  iface->serialize   = bz_flatpak_entry_real_serialize;
-  iface->deserialize = bz_flatpak_entry_real_deserialize;
+  iface->serialize           = bz_flatpak_entry_real_serialize;
+  iface->deserialize         = bz_flatpak_entry_real_deserialize;
+  iface->get_compact_type    = bz_flatpak_entry_real_get_compact_type;
+  iface->serialize_compact   = bz_flatpak_entry_real_serialize_compact;
+  iface->deserialize_compact = bz_flatpak_entry_real_deserialize_compact;
 }
 
 static guint
@@ -365,6 +469,8 @@ bz_flatpak_entry_new_for_ref (FlatpakRef    *ref,
   const char      *id                          = NULL;
   g_autofree char *unique_id                   = NULL;
   g_autofree char *unique_id_checksum          = NULL;
+  g_autofree char *appstream_link              = NULL;
+  g_autofree char *appstream_checksum          = NULL;
   guint64          download_size               = 0;
   const char      *title                       = NULL;
   const char      *eol                         = NULL;
@@ -470,6 +576,20 @@ bz_flatpak_entry_new_for_ref (FlatpakRef    *ref,
   self->flatpak_id      = flatpak_ref_format_ref (ref);
   self->flatpak_version = g_strdup (flatpak_ref_get_branch (ref));
 
+  /* Everything here is derived from the ref and the appstream
+   * data, so the commit of either tells if a cached copy is
+   * still current. The appstream directory is a link to the
+   * checkout of its commit
+   */
+  if (appstream_dir != NULL)
+    appstream_link = g_file_read_link (appstream_dir, NULL);
+  if (appstream_link != NULL)
+    appstream_checksum = g_path_get_basename (appstream_link);
+  self->cache_validator = g_strdup_printf (
+      "%s:%s",
+      flatpak_ref_get_commit (ref) != NULL ? flatpak_ref_get_commit (ref) : "",
+      appstream_checksum != NULL ? appstream_checksum : "");
+
   id                 = flatpak_ref_get_name (ref);
   unique_id          = bz_flatpak_ref_format_unique (ref, user);
   unique_id_checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, unique_id, -1);
@@ -1058,6 +1178,13 @@ bz_flatpak_entry_get_addon_extension_of_ref (BzFlatpakEntry *self)
   return self->addon_extension_of_ref;
 }
 
+const char *
+bz_flatpak_entry_get_cache_validator (BzFlatpakEntry *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATPAK_ENTRY (self), NULL);
+  return self->cache_validator;
+}
+
 char *
 bz_flatpak_entry_extract_id_from_unique_id (const char *unique_id)
 {
@@ -1135,4 +1262,5 @@ clear_entry (BzFlatpakEntry *self)
   g_clear_pointer (&self->application_command, g_free);
   g_clear_pointer (&self->runtime_name, g_free);
   g_clear_pointer (&self->addon_extension_of_ref, g_free);
+  g_clear_pointer (&self->cache_validator, g_free);
 }
@@ -52,6 +52,9 @@ bz_flatpak_entry_get_runtime_name (BzFlatpakEntry *self);
 const char *
 bz_flatpak_entry_get_addon_extension_of_ref (BzFlatpakEntry *self);
 
+const char *
+bz_flatpak_entry_get_cache_validator (BzFlatpakEntry *self);
+
 char *
 bz_flatpak_entry_extract_id_from_unique_id (const char *unique_id);
 
@@ -22,7 +22,6 @@
 #define PURESTORE_MODULE "flatpak"
 
 #include <malloc.h>
-#include <xmlb.h>
 
 #include "bz-backend-notification.h"
 #include "bz-backend-transaction-op-payload.h"
@@ -1061,12 +1060,6 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
   g_autofree char *appstream_dir_path     = NULL;
   g_autofree char *appstream_xml_path     = NULL;
   g_autoptr (GFile) appstream_xml         = NULL;
-  g_autoptr (XbBuilderSource) source      = NULL;
-  g_autoptr (XbBuilder) builder           = NULL;
-  const gchar *const *locales             = NULL;
-  g_autoptr (XbSilo) silo                 = NULL;
-  g_autoptr (XbNode) root                 = NULL;
-  g_autoptr (GPtrArray) children          = NULL;
   g_autoptr (AsMetadata) metadata         = NULL;
   AsComponentBox *components              = NULL;
   g_autoptr (GHashTable) component_hash   = NULL;
@@ -1126,96 +1119,34 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
 
   appstream_xml = g_file_new_for_path (appstream_xml_path);
 
-  source = xb_builder_source_new ();
-  result = xb_builder_source_load_file (
-      source,
-      appstream_xml,
-      XB_BUILDER_SOURCE_FLAG_WATCH_FILE |
-          XB_BUILDER_SOURCE_FLAG_LITERAL_TEXT,
-      cancellable,
-      &local_error);
-  if (!result)
-    return dex_future_new_reject (
-        BZ_FLATPAK_ERROR,
-        BZ_FLATPAK_ERROR_IO_MISBEHAVIOR,
-        "Failed to load binary xml from appstream bundle download at path %s for remote '%s': %s",
-        appstream_xml_path,
-        remote_name,
-        local_error->message);
-
-  builder = xb_builder_new ();
-  locales = g_get_language_names ();
-  for (guint i = 0; locales[i] != NULL; i++)
-    xb_builder_add_locale (builder, locales[i]);
-  xb_builder_import_source (builder, source);
-
-  silo = xb_builder_compile (
-      builder,
-
-      /* This was causing issues */
-      // // fallback for locales should be handled by AppStream as_component_get_name
-      // XB_BUILDER_COMPILE_FLAG_NONE,
-
-      /* This seems to work better */
-      XB_BUILDER_COMPILE_FLAG_NATIVE_LANGS,
-      cancellable,
-      &local_error);
+  /* Parse the whole catalog in one pass. Going through an
+   * xmlb silo first meant exporting every component back
+   * to xml text and parsing it again. AsMetadata only keeps
+   * translations for the current locale, like the silo did
+   */
+  metadata = as_metadata_new ();
+  result   = as_metadata_parse_file (
+      metadata, appstream_xml,
+      AS_FORMAT_KIND_XML, &local_error);
 
 #ifdef __GLIBC__
   /* From gnome-software/plugins/core/gs-plugin-appstream.c
    *
    * https://gitlab.gnome.org/GNOME/gnome-software/-/issues/941
-   * libxmlb <= 0.3.22 makes lots of temporary heap allocations parsing large XMLs
+   * Parsing large XMLs makes lots of temporary heap allocations,
    * trim the heap after parsing to control RSS growth. */
   malloc_trim (0);
 #endif
 
-  if (silo == NULL)
+  if (!result)
     return dex_future_new_reject (
         BZ_FLATPAK_ERROR,
-        BZ_FLATPAK_ERROR_IO_MISBEHAVIOR,
-        "Failed to compile binary xml silo from appstream bundle download at path %s for remote '%s': %s",
+        BZ_FLATPAK_ERROR_APPSTREAM_FAILURE,
+        "Failed to create appstream metadata from appstream bundle download at path %s for remote '%s': %s",
         appstream_xml_path,
         remote_name,
         local_error->message);
 
-  root     = xb_silo_get_root (silo);
-  children = xb_node_get_children (root);
-  metadata = as_metadata_new ();
-
-  for (guint i = 0; i < children->len; i++)
-    {
-      XbNode          *component_node = NULL;
-      g_autofree char *component_xml  = NULL;
-
-      component_node = g_ptr_array_index (children, i);
-
-      component_xml = xb_node_export (
-          component_node, XB_NODE_EXPORT_FLAG_NONE, &local_error);
-      if (component_xml == NULL)
-        return dex_future_new_reject (
-            BZ_FLATPAK_ERROR,
-            BZ_FLATPAK_ERROR_IO_MISBEHAVIOR,
-            "Failed to export plain xml from appstream bundle silo "
-            "originating from download at path %s for remote '%s': %s",
-            appstream_xml_path,
-            remote_name,
-            local_error->message);
-
-      result = as_metadata_parse_data (
-          metadata, component_xml, -1,
-          AS_FORMAT_KIND_XML, &local_error);
-      if (!result)
-        return dex_future_new_reject (
-            BZ_FLATPAK_ERROR,
-            BZ_FLATPAK_ERROR_APPSTREAM_FAILURE,
-            "Failed to create appstream metadata from appstream bundle silo "
-            "originating from download at path %s for remote '%s': %s",
-            appstream_xml_path,
-            remote_name,
-            local_error->message);
-    }
-
   components     = as_metadata_get_components (metadata);
   component_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
   for (guint i = 0; i < as_component_box_len (components); i++)
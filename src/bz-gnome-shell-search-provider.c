@@ -39,6 +39,11 @@ struct _BzGnomeShellSearchProvider
 
 G_DEFINE_FINAL_TYPE (BzGnomeShellSearchProvider, bz_gnome_shell_search_provider, G_TYPE_OBJECT);
 
+/* The shell only ever displays a handful of results
+ * per provider, so there is no use in ranking more
+ */
+#define MAX_RESULTS 20
+
 enum
 {
   PROP_0,
@@ -185,30 +190,42 @@ get_result_metas (BzShellSearchProvider2     *skeleton,
 
   for (char **result = results; *result != NULL; result++)
     {
-      BzEntryGroup *group                      = NULL;
+      BzSearchResult *search_result            = NULL;
+      BzEntryGroup   *group                    = NULL;
       g_autoptr (GVariantBuilder) meta_builder = NULL;
       const char *title                        = NULL;
       const char *description                  = NULL;
       GIcon      *icon                         = NULL;
 
-      group = g_hash_table_lookup (self->last_results, *result);
-      if (group == NULL)
+      search_result = g_hash_table_lookup (self->last_results, *result);
+      if (search_result == NULL)
         {
           g_warning ("failed to find '%s' in gnome-shell search result cache", *result);
           continue;
         }
 
+      /* Results from the persisted index have no group
+       * yet, only the strings that were saved with it
+       */
+      group = bz_search_result_get_group (search_result);
+      if (group != NULL)
+        {
+          title       = bz_entry_group_get_title (group);
+          description = bz_entry_group_get_description (group);
+          icon        = bz_entry_group_get_mini_icon (group);
+        }
+      else
+        {
+          title       = bz_search_result_get_title (search_result);
+          description = bz_search_result_get_description (search_result);
+        }
+
       meta_builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
       g_variant_builder_add (meta_builder, "{sv}", "id", g_variant_new_string (*result));
-
-      title = bz_entry_group_get_title (group);
       g_variant_builder_add (meta_builder, "{sv}", "name", g_variant_new_string (title));
-
-      description = bz_entry_group_get_description (group);
       if (description != NULL)
         g_variant_builder_add (meta_builder, "{sv}", "description", g_variant_new_string (description));
 
-      icon = bz_entry_group_get_mini_icon (group);
       if (icon != NULL)
         {
           g_autofree gchar *icon_str = g_icon_to_string (icon);
@@ -387,13 +404,16 @@ request_finally (DexFuture   *future,
 
           result = g_ptr_array_index (results, i);
           group  = bz_search_result_get_group (result);
-          id     = bz_entry_group_get_id (group);
+          if (group != NULL)
+            id = bz_entry_group_get_id (group);
+          else
+            id = bz_search_result_get_id (result);
 
           g_variant_builder_add (builder, "s", id);
           g_hash_table_replace (
               self->last_results,
               g_strdup (id),
-              g_object_ref (group));
+              g_object_ref (result));
         }
 
       g_dbus_method_invocation_return_value (
@@ -447,7 +467,8 @@ start_request (BzGnomeShellSearchProvider *self,
   data->application = g_application_get_default ();
   g_application_hold (data->application);
 
-  future = bz_search_engine_query (self->engine, terms);
+  future = bz_search_engine_query_limited (
+      self->engine, terms, BZ_SEARCH_FILTER_NONE, MAX_RESULTS, NULL);
   future = dex_future_finally (
       future, (DexFutureCallback) request_finally,
       request_data_ref (data), request_data_unref);
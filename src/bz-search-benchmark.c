@@ -0,0 +1,581 @@
+/* bz-search-benchmark.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "PURESTORE::SEARCH-BENCHMARK"
+
+#include <libdex.h>
+#include <math.h>
+
+#include "bz-application-map-factory.h"
+#include "bz-entry-group.h"
+#include "bz-entry.h"
+#include "bz-env.h"
+#include "bz-search-engine.h"
+#include "bz-util.h"
+
+/* Every call into the allocator is counted, including the
+ * ones GLib makes on behalf of the engine. Only glibc lets
+ * us forward to the real allocator without dlsym ()
+ */
+#ifdef __GLIBC__
+#define HAVE_ALLOCATION_COUNTER 1
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb,
+                            size_t size);
+extern void *__libc_realloc (void  *ptr,
+                             size_t size);
+
+static gsize n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+  g_atomic_pointer_add (&n_allocations, 1);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb,
+        size_t size)
+{
+  g_atomic_pointer_add (&n_allocations, 1);
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void  *ptr,
+         size_t size)
+{
+  g_atomic_pointer_add (&n_allocations, 1);
+  return __libc_realloc (ptr, size);
+}
+
+#define GET_ALLOCATIONS() ((gsize) g_atomic_pointer_get (&n_allocations))
+#else
+#define HAVE_ALLOCATION_COUNTER 0
+#define GET_ALLOCATIONS()       ((gsize) 0)
+#endif
+
+/* BzEntry is abstract, this one only carries
+ * the properties the search engine looks at
+ */
+#define BZ_TYPE_BENCH_ENTRY (bz_bench_entry_get_type ())
+G_DECLARE_FINAL_TYPE (BzBenchEntry, bz_bench_entry, BZ, BENCH_ENTRY, BzEntry)
+
+struct _BzBenchEntry
+{
+  BzEntry parent_instance;
+};
+
+G_DEFINE_FINAL_TYPE (BzBenchEntry, bz_bench_entry, BZ_TYPE_ENTRY);
+
+static void
+bz_bench_entry_class_init (BzBenchEntryClass *klass)
+{
+}
+
+static void
+bz_bench_entry_init (BzBenchEntry *self)
+{
+}
+
+/* The corpus sizes run when none is given */
+static const guint default_sizes[] = { 1000, 10000, 50000 };
+
+static const char *const vocabulary[] = {
+  "audio", "browser", "calculator", "calendar", "camera", "chat",
+  "clock", "code", "color", "compiler", "console", "converter",
+  "database", "debugger", "desktop", "diagram", "dictionary", "disk",
+  "document", "download", "drawing", "editor", "email", "emulator",
+  "file", "finance", "font", "game", "graphics", "image", "kernel",
+  "keyboard", "manager", "map", "markdown", "media", "monitor",
+  "music", "network", "notes", "office", "paint", "password",
+  "photo", "player", "podcast", "presentation", "printer", "puzzle",
+  "reader", "recorder", "remote", "scanner", "screenshot", "server",
+  "spreadsheet", "studio", "system", "terminal", "text", "theme",
+  "timer", "torrent", "translator", "video", "viewer", "virtual",
+  "weather", "web", "writer",
+};
+
+static const char *const brands[] = {
+  "Firefox", "GIMP", "Inkscape", "Blender", "Krita", "Audacity",
+  "LibreOffice", "Thunderbird", "Steam", "Discord", "Spotify", "OBS",
+  "Kdenlive", "Shotwell", "Rhythmbox", "Lollypop", "Amberol", "Fragments",
+  "Secrets", "Foliate", "Apostrophe", "Builder", "Boxes", "Tangram",
+  "Dialect", "Komikku", "Shortwave", "Solanum", "Warp", "Zrythm",
+};
+
+static const char *const developers[] = {
+  "The GNOME Project", "KDE", "Mozilla", "The Document Foundation",
+  "Valve Corporation", "Blender Foundation", "Independent", "Purism",
+  "elementary", "Collabora", "Igalia", "Red Hat",
+};
+
+/* Typed keystroke by keystroke when no log is given */
+static const char *const default_queries[] = {
+  "firefox", "text editor", "gimp", "video player", "obs studio",
+  "libreoffice writer", "steam", "music", "password manager",
+  "screenshot", "blender", "pdf reader", "terminal emulator",
+  "photo editor", "weather", "krita paint", "spotify", "disk usage",
+  "markdown notes", "virtual machine",
+};
+
+BZ_DEFINE_DATA (
+    bench,
+    Bench,
+    {
+      GArray    *sizes;
+      GPtrArray *keystrokes;
+      guint      passes;
+      guint32    seed;
+      GMainLoop *loop;
+      int        status;
+    },
+    BZ_RELEASE_DATA (sizes, g_array_unref);
+    BZ_RELEASE_DATA (keystrokes, g_ptr_array_unref);
+    BZ_RELEASE_DATA (loop, g_main_loop_unref))
+static DexFuture *
+bench_fiber (BenchData *data);
+
+static DexFuture *
+bench_finally (DexFuture *future,
+               BenchData *data);
+
+static GListModel *
+build_corpus (BzApplicationMapFactory *factory,
+              guint                    n_groups,
+              guint32                  seed);
+
+static GPtrArray *
+build_keystrokes (void);
+
+static GPtrArray *
+load_keystrokes (const char *path,
+                 GError    **error);
+
+static char **
+split_terms (const char *text);
+
+static gint
+cmp_latencies (gint64 *a,
+               gint64 *b);
+
+static double
+percentile_ms (GArray *latencies,
+               double  percentile);
+
+static GListModel *
+dummy_map (gpointer item,
+           gpointer user_data);
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr (GOptionContext) context = NULL;
+  g_autoptr (GError) local_error     = NULL;
+  g_auto (GStrv) sizes               = NULL;
+  g_autofree char *log_path          = NULL;
+  int              passes            = 3;
+  int              seed              = 1;
+  g_autoptr (BenchData) data         = NULL;
+  g_autoptr (DexFuture) future       = NULL;
+  GOptionEntry entries[]             = {
+    { "groups", 'n', 0, G_OPTION_ARG_STRING_ARRAY, &sizes,
+     "Number of groups in a corpus, may be given more than once", "N" },
+    { "log", 'l', 0, G_OPTION_ARG_FILENAME, &log_path,
+     "Replay the search texts in FILE, one keystroke per line", "FILE" },
+    { "passes", 'p', 0, G_OPTION_ARG_INT, &passes,
+     "How many times the keystrokes are replayed", "N" },
+    { "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+     "Seed of the synthetic corpus", "N" },
+    { NULL }
+  };
+
+  context = g_option_context_new ("- benchmark the search engine");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &local_error))
+    {
+      g_printerr ("%s\n", local_error->message);
+      return 1;
+    }
+
+  dex_init ();
+
+  data         = bench_data_new ();
+  data->sizes  = g_array_new (FALSE, FALSE, sizeof (guint));
+  data->passes = MAX (1, passes);
+  data->seed   = seed;
+
+  if (sizes != NULL)
+    {
+      for (char **size = sizes; *size != NULL; size++)
+        {
+          guint64 parsed   = 0;
+          guint   n_groups = 0;
+
+          if (!g_ascii_string_to_unsigned (*size, 10, 1, G_MAXUINT, &parsed, &local_error))
+            {
+              g_printerr ("Invalid number of groups '%s': %s\n", *size, local_error->message);
+              return 1;
+            }
+          n_groups = parsed;
+          g_array_append_val (data->sizes, n_groups);
+        }
+    }
+  else
+    g_array_append_vals (data->sizes, default_sizes, G_N_ELEMENTS (default_sizes));
+
+  if (log_path != NULL)
+    {
+      data->keystrokes = load_keystrokes (log_path, &local_error);
+      if (data->keystrokes == NULL)
+        {
+          g_printerr ("%s\n", local_error->message);
+          return 1;
+        }
+    }
+  else
+    data->keystrokes = build_keystrokes ();
+
+  data->loop = g_main_loop_new (NULL, FALSE);
+  future     = dex_scheduler_spawn (
+      dex_scheduler_get_default (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) bench_fiber,
+      bench_data_ref (data), bench_data_unref);
+  future = dex_future_finally (
+      future, (DexFutureCallback) bench_finally,
+      bench_data_ref (data), bench_data_unref);
+
+  g_main_loop_run (data->loop);
+  return data->status;
+}
+
+static DexFuture *
+bench_fiber (BenchData *data)
+{
+  g_autoptr (BzApplicationMapFactory) factory = NULL;
+
+  factory = bz_application_map_factory_new (
+      (GtkMapListModelMapFunc) dummy_map,
+      NULL, NULL, NULL, NULL);
+
+  g_print ("%8s %10s %10s %9s %9s %9s %9s %11s %12s\n",
+           "groups", "keystrokes", "index ms",
+           "p50 ms", "p95 ms", "p99 ms", "max ms",
+           "queries/s", "allocs/query");
+
+  for (guint i = 0; i < data->sizes->len; i++)
+    {
+      guint n_groups                    = 0;
+      g_autoptr (GListModel) corpus     = NULL;
+      g_autoptr (BzSearchEngine) engine = NULL;
+      gint64 index_start                = 0;
+      gint64 index_us                   = 0;
+      g_autoptr (GArray) latencies      = NULL;
+      gint64 total_us                   = 0;
+      gsize  allocations_start          = 0;
+      gsize  allocations                = 0;
+
+      n_groups = g_array_index (data->sizes, guint, i);
+      corpus   = build_corpus (factory, n_groups, data->seed);
+      engine   = bz_search_engine_new ();
+
+      index_start = g_get_monotonic_time ();
+      bz_search_engine_set_model (engine, corpus);
+      dex_await (bz_search_engine_wait_for_index (engine), NULL);
+      index_us = g_get_monotonic_time () - index_start;
+
+      latencies         = g_array_new (FALSE, FALSE, sizeof (gint64));
+      allocations_start = GET_ALLOCATIONS ();
+
+      for (guint pass = 0; pass < data->passes; pass++)
+        {
+          for (guint j = 0; j < data->keystrokes->len; j++)
+            {
+              const char *text               = NULL;
+              g_auto (GStrv) terms           = NULL;
+              gint64 start                   = 0;
+              gint64 elapsed                 = 0;
+              g_autoptr (GPtrArray) results  = NULL;
+              g_autoptr (GError) local_error = NULL;
+
+              /* The widget never queries without terms */
+              text  = g_ptr_array_index (data->keystrokes, j);
+              terms = split_terms (text);
+              if (terms == NULL)
+                continue;
+
+              start   = g_get_monotonic_time ();
+              results = dex_await_boxed (
+                  bz_search_engine_query_limited (
+                      engine, (const char *const *) terms,
+                      BZ_SEARCH_FILTER_NONE, 0, NULL),
+                  &local_error);
+              elapsed = g_get_monotonic_time () - start;
+
+              if (results == NULL)
+                return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+              g_array_append_val (latencies, elapsed);
+              total_us += elapsed;
+            }
+        }
+
+      allocations = GET_ALLOCATIONS () - allocations_start;
+      g_array_sort (latencies, (GCompareFunc) cmp_latencies);
+
+      g_print ("%8u %10u %10.1f %9.3f %9.3f %9.3f %9.3f %11.0f ",
+               n_groups,
+               latencies->len,
+               (double) index_us / 1000.0,
+               percentile_ms (latencies, 0.50),
+               percentile_ms (latencies, 0.95),
+               percentile_ms (latencies, 0.99),
+               percentile_ms (latencies, 1.00),
+               total_us > 0 ? (double) latencies->len * G_USEC_PER_SEC / (double) total_us : 0.0);
+      if (HAVE_ALLOCATION_COUNTER && latencies->len > 0)
+        g_print ("%12.1f\n", (double) allocations / (double) latencies->len);
+      else
+        g_print ("%12s\n", "n/a");
+    }
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+bench_finally (DexFuture *future,
+               BenchData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+
+  if (!dex_future_get_value (future, &local_error))
+    {
+      g_printerr ("Benchmark failed: %s\n", local_error->message);
+      data->status = 1;
+    }
+
+  g_main_loop_quit (data->loop);
+  return NULL;
+}
+
+static GListModel *
+build_corpus (BzApplicationMapFactory *factory,
+              guint                    n_groups,
+              guint32                  seed)
+{
+  g_autoptr (GRand) rng         = NULL;
+  g_autoptr (GListStore) store = NULL;
+  g_autoptr (GPtrArray) groups = NULL;
+
+  /* The same seed always yields the same corpus,
+   * so runs on different commits are comparable
+   */
+  rng    = g_rand_new_with_seed (seed ^ n_groups);
+  store  = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
+  groups = g_ptr_array_new_with_free_func (g_object_unref);
+
+#define PICK(_array) ((_array)[g_rand_int_range (rng, 0, G_N_ELEMENTS (_array))])
+
+  for (guint i = 0; i < n_groups; i++)
+    {
+      g_autoptr (GString) title       = NULL;
+      g_autoptr (GString) description = NULL;
+      g_autoptr (GPtrArray) tokens    = NULL;
+      g_autofree char *id             = NULL;
+      g_autofree char *unique_id      = NULL;
+      g_autoptr (BzEntry) entry       = NULL;
+      g_autoptr (BzEntryGroup) group  = NULL;
+      guint n_words                   = 0;
+
+      /* About a third of the catalog is
+       * named after something well known
+       */
+      title = g_string_new (NULL);
+      if (g_rand_int_range (rng, 0, 3) == 0)
+        g_string_append (title, PICK (brands));
+      else
+        {
+          const char *word = PICK (vocabulary);
+
+          g_string_append_c (title, g_ascii_toupper (word[0]));
+          g_string_append (title, word + 1);
+        }
+      n_words = g_rand_int_range (rng, 0, 3);
+      for (guint j = 0; j < n_words; j++)
+        g_string_append_printf (title, " %s", PICK (vocabulary));
+
+      description = g_string_new (NULL);
+      n_words     = g_rand_int_range (rng, 4, 12);
+      for (guint j = 0; j < n_words; j++)
+        g_string_append_printf (description, "%s%s", j > 0 ? " " : "", PICK (vocabulary));
+
+      tokens  = g_ptr_array_new_with_free_func (g_free);
+      n_words = g_rand_int_range (rng, 0, 6);
+      for (guint j = 0; j < n_words; j++)
+        g_ptr_array_add (tokens, g_strdup (PICK (vocabulary)));
+
+      id        = g_strdup_printf ("org.bench.App%u", i);
+      unique_id = g_strdup_printf ("flatpak+user:flathub/app/%s/x86_64/stable", id);
+
+      entry = g_object_new (
+          BZ_TYPE_BENCH_ENTRY,
+          "id", id,
+          "unique-id", unique_id,
+          "title", title->str,
+          "developer", PICK (developers),
+          "description", description->str,
+          "search-tokens", tokens,
+          "is-floss", g_rand_boolean (rng),
+          "is-flathub", g_rand_int_range (rng, 0, 5) > 0,
+          NULL);
+
+      group = bz_entry_group_new (factory, NULL);
+      bz_entry_group_add (group, entry, NULL);
+      g_ptr_array_add (groups, g_steal_pointer (&group));
+    }
+
+#undef PICK
+
+  /* A single items-changed, as after a refresh */
+  g_list_store_splice (store, 0, 0, groups->pdata, groups->len);
+  return G_LIST_MODEL (g_steal_pointer (&store));
+}
+
+static GPtrArray *
+build_keystrokes (void)
+{
+  g_autoptr (GPtrArray) keystrokes = NULL;
+
+  keystrokes = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < G_N_ELEMENTS (default_queries); i++)
+    {
+      const char *query = default_queries[i];
+      gsize       len   = strlen (query);
+
+      for (gsize j = 1; j <= len; j++)
+        {
+          g_ptr_array_add (keystrokes, g_strndup (query, j));
+
+          /* Every few queries get a typo
+           * which is noticed and erased
+           */
+          if (i % 3 == 0 && j == len / 2)
+            {
+              g_ptr_array_add (keystrokes, g_strdup_printf ("%.*sx", (int) j, query));
+              g_ptr_array_add (keystrokes, g_strndup (query, j));
+            }
+        }
+
+      /* Then the text is cleared again */
+      for (gsize j = len; j > 0; j--)
+        g_ptr_array_add (keystrokes, g_strndup (query, j - 1));
+    }
+
+  return g_steal_pointer (&keystrokes);
+}
+
+static GPtrArray *
+load_keystrokes (const char *path,
+                 GError    **error)
+{
+  g_autofree char *contents        = NULL;
+  g_auto (GStrv) lines             = NULL;
+  g_autoptr (GPtrArray) keystrokes = NULL;
+
+  if (!g_file_get_contents (path, &contents, NULL, error))
+    return NULL;
+
+  lines      = g_strsplit (contents, "\n", -1);
+  keystrokes = g_ptr_array_new_with_free_func (g_free);
+  for (char **line = lines; *line != NULL; line++)
+    {
+      if (!g_utf8_validate (*line, -1, NULL))
+        {
+          g_set_error (
+              error,
+              G_IO_ERROR,
+              G_IO_ERROR_INVALID_DATA,
+              "Query log '%s' is not valid UTF-8",
+              path);
+          return NULL;
+        }
+      g_ptr_array_add (keystrokes, g_strdup (*line));
+    }
+
+  return g_steal_pointer (&keystrokes);
+}
+
+/* Mirrors how the search widget tokenizes its text */
+static char **
+split_terms (const char *text)
+{
+  g_autoptr (GStrvBuilder) builder = NULL;
+  g_auto (GStrv) tokens            = NULL;
+  guint n_terms                    = 0;
+
+  builder = g_strv_builder_new ();
+  tokens  = g_strsplit_set (text, " \t\n", -1);
+  for (char **token = tokens; *token != NULL; token++)
+    {
+      if (**token != '\0')
+        {
+          g_strv_builder_add (builder, *token);
+          n_terms++;
+        }
+    }
+
+  if (n_terms == 0)
+    return NULL;
+  return g_strv_builder_end (builder);
+}
+
+static gint
+cmp_latencies (gint64 *a,
+               gint64 *b)
+{
+  return (*a > *b) - (*a < *b);
+}
+
+/* Nearest-rank percentile of the sorted `latencies` */
+static double
+percentile_ms (GArray *latencies,
+               double  percentile)
+{
+  guint rank = 0;
+
+  if (latencies->len == 0)
+    return 0.0;
+
+  rank = (guint) ceil (percentile * latencies->len);
+  rank = CLAMP (rank, 1, latencies->len);
+  return (double) g_array_index (latencies, gint64, rank - 1) / 1000.0;
+}
+
+static GListModel *
+dummy_map (gpointer item,
+           gpointer user_data)
+{
+  return NULL;
+}
+
+/* End of bz-search-benchmark.c */
@@ -18,31 +18,110 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#define G_LOG_DOMAIN  "PURESTORE::SEARCH-ENGINE"
+#define PURESTORE_MODULE "search-engine"
+
+#include <errno.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "bz-search-engine.h"
 #include "bz-entry-group.h"
 #include "bz-env.h"
+#include "bz-io.h"
+#include "bz-search-result-model.h"
 #include "bz-search-result.h"
 #include "bz-util.h"
 
-struct _BzSearchEngine
-{
-  GObject parent_instance;
+/* Bump whenever the layout of the persisted index changes */
+#define PERSISTED_INDEX_VERSION  2
+#define PERSISTED_INDEX_FILENAME "index"
 
-  GListModel *model;
-  GPtrArray  *mirror;
-};
+/* Version, catalog generation, the casefolded strings
+ * separated by NUL, their weights, the number of strings
+ * of every group and the id, title, description and
+ * filter flags of every group
+ */
+#define PERSISTED_INDEX_TYPE "(utayadaua(sssu))"
 
-G_DEFINE_FINAL_TYPE (BzSearchEngine, bz_search_engine, G_TYPE_OBJECT);
+#define FNV_OFFSET_BASIS G_GUINT64_CONSTANT (0xcbf29ce484222325)
+#define FNV_PRIME        G_GUINT64_CONSTANT (0x100000001b3)
 
-enum
-{
-  PROP_0,
+/* Length of the n-grams used to narrow down
+ * which groups are considered for a query
+ */
+#define GRAM_LENGTH 3
 
-  PROP_MODEL,
+BZ_DEFINE_DATA (
+    gram_index,
+    GramIndex,
+    {
+      /* gram key -> GArray of ascending group indices */
+      GHashTable *postings;
+    },
+    BZ_RELEASE_DATA (postings, g_hash_table_unref))
 
-  LAST_PROP
-};
-static GParamSpec *props[LAST_PROP] = { 0 };
+/* Typos are found through a dictionary holding every variant
+ * of the title and developer words with up to this many
+ * characters deleted. A query word reaches a dictionary word
+ * within this edit distance by deleting as many from itself
+ */
+#define MAX_TYPO_DISTANCE 2
+
+/* Only the leading characters of a word take part, which
+ * bounds the number of variants of long words
+ */
+#define TYPO_PREFIX_LENGTH 7
+
+/* Words shorter than this are too ambiguous to correct */
+#define MIN_TYPO_WORD_LENGTH 3
+
+/* Share of a match that every edit costs */
+#define TYPO_EDIT_PENALTY 0.25
+
+BZ_DEFINE_DATA (
+    typo_index,
+    TypoIndex,
+    {
+      /* word id -> casefolded word */
+      GPtrArray  *words;
+      /* word id -> GArray of ascending group indices */
+      GPtrArray  *word_groups;
+      /* hash of a variant -> GArray of word ids */
+      GHashTable *deletes;
+    },
+    BZ_RELEASE_DATA (words, g_ptr_array_unref);
+    BZ_RELEASE_DATA (word_groups, g_ptr_array_unref);
+    BZ_RELEASE_DATA (deletes, g_hash_table_unref))
+
+/* How many recent queries are remembered so
+ * refinements and backspaces can reuse them
+ */
+#define MAX_CACHED_QUERIES 16
+
+BZ_DEFINE_DATA (
+    cached_query,
+    CachedQuery,
+    {
+      char   *query;
+      guint   filter;
+      GArray *scores;
+    },
+    BZ_RELEASE_DATA (query, g_free);
+    BZ_RELEASE_DATA (scores, g_array_unref))
+
+BZ_DEFINE_DATA (
+    query_cache,
+    QueryCache,
+    {
+      GMutex     mutex;
+      guint      generation;
+      GPtrArray *entries;
+    },
+    BZ_RELEASE_DATA (entries, g_ptr_array_unref);
+    g_mutex_clear (&self->mutex))
 
 static void
 items_changed (BzSearchEngine *self,
@@ -51,24 +130,25 @@ items_changed (BzSearchEngine *self,
                guint           added,
                GListModel     *model);
 
-typedef struct
-{
-  gunichar     ch;
-  GUnicodeType type;
-} IndexedChar;
-
+/* `chars` is only allocated for strings containing
+ * non-ASCII characters; otherwise the bytes at `ptr`
+ * are the code points. See `istring_char_at ()`
+ */
 BZ_DEFINE_DATA (
     indexed_string,
     IndexedString,
     {
-      char        *ptr;
-      glong        utf8_len;
-      IndexedChar *chars;
-      double       weight;
+      char     *ptr;
+      glong     utf8_len;
+      gunichar *chars;
+      double    weight;
     },
     BZ_RELEASE_DATA (ptr, g_free);
     BZ_RELEASE_DATA (chars, g_free))
 
+static inline char *
+normalize_string (const char *s);
+
 static inline void
 index_string (const char        *s,
               IndexedStringData *out);
@@ -77,61 +157,375 @@ static inline double
 test_strings (IndexedStringData *query,
               IndexedStringData *against);
 
+static inline gunichar
+istring_char_at (IndexedStringData *istring,
+                 glong              i);
+
+static inline guint
+make_gram (IndexedStringData *istring,
+           glong              i);
+
+/* Holds the indexed strings of a batch of groups in a few
+ * flat allocations. The `IndexedStringData` records point
+ * into `strings` and `chars` and are never freed one by one.
+ * An arena loaded from disk has no `strings`; its records
+ * point into the mapped file kept alive by `backing`
+ */
 BZ_DEFINE_DATA (
-    group,
-    Group,
+    string_arena,
+    StringArena,
     {
-      BzEntryGroup   *group;
-      GArray         *istrings;
-      BzSearchResult *default_result;
+      char              *strings;
+      GVariant          *backing;
+      gunichar          *chars;
+      IndexedStringData *istrings;
+      guint              n_istrings;
     },
-    BZ_RELEASE_DATA (group, g_object_unref);
-    BZ_RELEASE_DATA (istrings, g_array_unref);
-    BZ_RELEASE_DATA (default_result, g_object_unref))
+    BZ_RELEASE_DATA (strings, g_free);
+    BZ_RELEASE_DATA (backing, g_variant_unref);
+    BZ_RELEASE_DATA (chars, g_free);
+    BZ_RELEASE_DATA (istrings, g_free))
 
 typedef struct
 {
-  guint  idx;
-  double val;
-} Score;
+  BzEntryGroup    *group;
+  BzSearchResult  *default_result;
+  StringArenaData *arena;
+  guint            first_istring;
+  guint            n_istrings;
+  /* `BzSearchFilterFlags` the group satisfies */
+  guint            flags;
+} GroupRecord;
+
+static void
+group_record_clear (GroupRecord *record);
+
+static GArray *
+group_records_new (guint reserved);
+
+static void
+append_group_records (GArray *dest,
+                      GArray *src,
+                      guint   position,
+                      guint   n);
+
+static void
+arena_add_string (GByteArray *strings,
+                  GArray     *chars,
+                  GArray     *istrings,
+                  const char *s,
+                  double      weight);
+
+static StringArenaData *
+string_arena_new_take (GByteArray *strings,
+                       GArray     *chars,
+                       GArray     *istrings);
+
+static void
+string_arena_relocate (StringArenaData *arena,
+                       char            *strings);
+
+/* An immutable view of the index. Every query holds a
+ * reference to the snapshot it started with, while
+ * items-changed publishes a new one in place of the old.
+ * Snapshots loaded from disk have no group objects, so
+ * they carry the id, title and description in `metas`
+ */
+BZ_DEFINE_DATA (
+    index_snapshot,
+    IndexSnapshot,
+    {
+      GArray        *groups;
+      GramIndexData *grams;
+      TypoIndexData *typos;
+      GVariant      *metas;
+    },
+    BZ_RELEASE_DATA (groups, g_array_unref);
+    BZ_RELEASE_DATA (grams, gram_index_data_unref);
+    BZ_RELEASE_DATA (typos, typo_index_data_unref);
+    BZ_RELEASE_DATA (metas, g_variant_unref))
+
+static IndexSnapshotData *
+index_snapshot_new_take (GArray *groups);
+
+struct _BzSearchEngine
+{
+  GObject parent_instance;
+
+  GListModel        *model;
+  IndexSnapshotData *snapshot;
+  IndexSnapshotData *persisted;
+  QueryCacheData    *cache;
+
+  /* The records of the model as it is now, which
+   * `snapshot` catches up with once `building` is done
+   */
+  GArray    *records;
+  DexFuture *building;
+  guint      build_generation;
+};
+
+G_DEFINE_FINAL_TYPE (BzSearchEngine, bz_search_engine, G_TYPE_OBJECT);
+
+enum
+{
+  PROP_0,
+
+  PROP_MODEL,
+
+  LAST_PROP
+};
+static GParamSpec *props[LAST_PROP] = { 0 };
+
+typedef BzSearchScore Score;
 
 static gint
 cmp_scores (Score *a,
             Score *b);
 
-#define PERFECT        1.0
-#define ALMOST_PERFECT 0.95
-#define SAME_CLASS     0.2
-#define SAME_CLUSTER   0.1
-#define NO_MATCH       0.0
+static void
+score_heap_push (GArray *heap,
+                 guint   limit,
+                 Score  *score);
+
+#define PERFECT 1.0
+
+/* Strings up to this many characters are matched
+ * with one bit per character position in a word
+ */
+#define MAX_BIT_PARALLEL_LEN 64
+
+static GramIndexData *
+build_gram_index (GArray *groups);
+
+static GArray *
+collect_candidates (GramIndexData     *grams,
+                    IndexedStringData *query_istring,
+                    guint              n_groups);
+
+static GArray *
+filter_candidates (GArray *groups,
+                   GArray *candidates,
+                   guint   filter);
+
+static TypoIndexData *
+build_typo_index (GArray *groups);
+
+static GArray *
+collect_typo_scores (TypoIndexData     *typos,
+                     IndexedStringData *query_istring,
+                     double             threshold,
+                     guint              n_groups);
+
+static GArray *
+merge_typo_candidates (GArray *candidates,
+                       GArray *typo_scores);
+
+static GPtrArray *
+split_words (const char *s);
+
+static GArray *
+collect_deletes (const gunichar *chars,
+                 guint           len,
+                 guint           distance);
+
+static guint
+osa_distance (const gunichar *a,
+              guint           a_len,
+              const gunichar *b,
+              guint           b_len);
+
+static gint
+cmp_indices (guint *a,
+             guint *b);
+
+static guint64
+hash_bytes (guint64       hash,
+            gconstpointer data,
+            gsize         size);
+
+static inline guint
+get_group_flags (BzEntryGroup *group);
+
+static void
+invalidate_query_cache (QueryCacheData *cache);
+
+static GArray *
+query_cache_lookup (QueryCacheData *cache,
+                    guint           generation,
+                    const char     *query,
+                    guint           filter,
+                    gboolean       *exact);
+
+static void
+query_cache_store (QueryCacheData *cache,
+                   guint           generation,
+                   const char     *query,
+                   guint           filter,
+                   GArray         *scores);
 
 BZ_DEFINE_DATA (
     query_task,
     QueryTask,
     {
-      char     **terms;
-      GPtrArray *shallow_mirror;
+      char             **terms;
+      IndexSnapshotData *snapshot;
+      QueryCacheData    *cache;
+      GCancellable      *cancellable;
+      guint              generation;
+      guint              filter;
+      guint              limit;
+      /* Resolve with the scores instead of results */
+      gboolean lazy;
     },
     BZ_RELEASE_DATA (terms, g_strfreev);
-    BZ_RELEASE_DATA (shallow_mirror, g_ptr_array_unref))
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref);
+    BZ_RELEASE_DATA (cache, query_cache_data_unref);
+    BZ_RELEASE_DATA (cancellable, g_object_unref))
 static DexFuture *
 query_task_fiber (QueryTaskData *data);
 
+static DexFuture *
+spawn_query_task (BzSearchEngine    *self,
+                  IndexSnapshotData *snapshot,
+                  const char *const *terms,
+                  guint              filter,
+                  guint              limit,
+                  gboolean           lazy,
+                  GCancellable      *cancellable);
+
+BZ_DEFINE_DATA (
+    query_into,
+    QueryInto,
+    {
+      BzSearchResultModel *model;
+      IndexSnapshotData   *snapshot;
+      GCancellable        *cancellable;
+    },
+    BZ_RELEASE_DATA (model, g_object_unref);
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref);
+    BZ_RELEASE_DATA (cancellable, g_object_unref))
+static DexFuture *
+query_into_then (DexFuture     *future,
+                 QueryIntoData *data);
+
+static void
+fill_search_result (BzSearchResult    *result,
+                    const Score       *score,
+                    IndexSnapshotData *snapshot);
+
+/* How many groups a sub-task claims at once. Small enough
+ * that no sub-task is left with a long tail of work, large
+ * enough to keep contention on the counter negligible
+ */
+#define WORK_CHUNK_LENGTH 64
+
+/* Shared by all sub-tasks of a query, which
+ * pull chunks of work from `next_chunk`
+ */
 BZ_DEFINE_DATA (
     query_sub_task,
     QuerySubTask,
     {
       IndexedStringData *query_istring;
-      GPtrArray         *shallow_mirror;
+      IndexSnapshotData *snapshot;
+      GArray            *candidates;
+      GArray            *typo_scores;
+      GCancellable      *cancellable;
       double             threshold;
-      guint              work_offset;
-      guint              work_length;
+      guint              n_work;
+      guint              limit;
+      int                next_chunk;
     },
-    BZ_RELEASE_DATA (query_istring, indexed_string_data_ref);
-    BZ_RELEASE_DATA (shallow_mirror, g_ptr_array_unref));
+    BZ_RELEASE_DATA (query_istring, indexed_string_data_unref);
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref);
+    BZ_RELEASE_DATA (candidates, g_array_unref);
+    BZ_RELEASE_DATA (typo_scores, g_array_unref);
+    BZ_RELEASE_DATA (cancellable, g_object_unref));
 static DexFuture *
 query_sub_task_fiber (QuerySubTaskData *data);
 
+static inline double
+score_group (GroupRecord       *record,
+             IndexedStringData *query_istring,
+             double             threshold);
+
+static inline IndexSnapshotData *
+get_active_snapshot (BzSearchEngine *self);
+
+static char *
+dup_index_path (void);
+
+static GVariant *
+map_index_file (const char *path,
+                GError    **error);
+
+BZ_DEFINE_DATA (
+    load_task,
+    LoadTask,
+    {
+      GWeakRef           engine_wr;
+      char              *path;
+      IndexSnapshotData *snapshot;
+    },
+    g_weak_ref_clear (&self->engine_wr);
+    BZ_RELEASE_DATA (path, g_free);
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref))
+static DexFuture *
+load_task_fiber (LoadTaskData *data);
+
+static DexFuture *
+load_index_then (DexFuture    *future,
+                 LoadTaskData *data);
+
+/* Builds the snapshot of `groups` away from the main
+ * thread. It is only published if nothing changed since
+ */
+BZ_DEFINE_DATA (
+    build_task,
+    BuildTask,
+    {
+      GWeakRef           engine_wr;
+      GArray            *groups;
+      IndexSnapshotData *snapshot;
+      guint              generation;
+    },
+    g_weak_ref_clear (&self->engine_wr);
+    BZ_RELEASE_DATA (groups, g_array_unref);
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref))
+static DexFuture *
+build_task_fiber (BuildTaskData *data);
+
+static DexFuture *
+build_snapshot_then (DexFuture     *future,
+                     BuildTaskData *data);
+
+static void
+rebuild_snapshot (BzSearchEngine *self,
+                  GArray         *groups);
+
+static DexFuture *
+wait_for_index_then (DexFuture *future,
+                     GWeakRef  *wr);
+
+static DexFuture *
+save_index_then (DexFuture *future,
+                 GWeakRef  *wr);
+
+BZ_DEFINE_DATA (
+    save_task,
+    SaveTask,
+    {
+      IndexSnapshotData *snapshot;
+      GVariant          *metas;
+      char              *path;
+    },
+    BZ_RELEASE_DATA (snapshot, index_snapshot_data_unref);
+    BZ_RELEASE_DATA (metas, g_variant_unref);
+    BZ_RELEASE_DATA (path, g_free))
+static DexFuture *
+save_task_fiber (SaveTaskData *data);
+
 static void
 bz_search_engine_dispose (GObject *object)
 {
@@ -141,7 +535,11 @@ bz_search_engine_dispose (GObject *object)
     g_signal_handlers_disconnect_by_func (self->model, items_changed, self);
   g_clear_object (&self->model);
 
-  g_clear_pointer (&self->mirror, g_ptr_array_unref);
+  g_clear_pointer (&self->snapshot, index_snapshot_data_unref);
+  g_clear_pointer (&self->persisted, index_snapshot_data_unref);
+  g_clear_pointer (&self->cache, query_cache_data_unref);
+  g_clear_pointer (&self->records, g_array_unref);
+  dex_clear (&self->building);
 
   G_OBJECT_CLASS (bz_search_engine_parent_class)->dispose (object);
 }
@@ -204,7 +602,12 @@ bz_search_engine_class_init (BzSearchEngineClass *klass)
 static void
 bz_search_engine_init (BzSearchEngine *self)
 {
-  self->mirror = g_ptr_array_new_with_free_func (group_data_unref);
+  self->records  = group_records_new (0);
+  self->snapshot = index_snapshot_new_take (g_array_ref (self->records));
+
+  self->cache          = query_cache_data_new ();
+  self->cache->entries = g_ptr_array_new_with_free_func (cached_query_data_unref);
+  g_mutex_init (&self->cache->mutex);
 }
 
 BzSearchEngine *
@@ -231,8 +634,15 @@ bz_search_engine_set_model (BzSearchEngine *self,
     g_signal_handlers_disconnect_by_func (self->model, items_changed, self);
   g_clear_object (&self->model);
 
-  if (self->mirror->len > 0)
-    g_ptr_array_remove_range (self->mirror, 0, self->mirror->len);
+  /* Whatever was being built is for the old model */
+  self->build_generation++;
+  dex_clear (&self->building);
+
+  g_clear_pointer (&self->records, g_array_unref);
+  g_clear_pointer (&self->snapshot, index_snapshot_data_unref);
+  self->records  = group_records_new (0);
+  self->snapshot = index_snapshot_new_take (g_array_ref (self->records));
+  invalidate_query_cache (self->cache);
 
   if (model != NULL)
     {
@@ -248,24 +658,48 @@ DexFuture *
 bz_search_engine_query (BzSearchEngine    *self,
                         const char *const *terms)
 {
+  return bz_search_engine_query_limited (self, terms, BZ_SEARCH_FILTER_NONE, 0, NULL);
+}
+
+DexFuture *
+bz_search_engine_query_limited (BzSearchEngine     *self,
+                                const char *const  *terms,
+                                BzSearchFilterFlags filter,
+                                guint               limit,
+                                GCancellable       *cancellable)
+{
+  IndexSnapshotData *snapshot = NULL;
+
   g_return_val_if_fail (BZ_IS_SEARCH_ENGINE (self), NULL);
   g_return_val_if_fail (terms != NULL && *terms != NULL, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
 
-  if (self->mirror->len == 0 || **terms == '\0')
+  snapshot = get_active_snapshot (self);
+  if (snapshot->groups->len == 0 || **terms == '\0')
     {
+      GArray *groups            = snapshot->groups;
       g_autoptr (GPtrArray) ret = NULL;
 
       ret = g_ptr_array_new_with_free_func (g_object_unref);
-      g_ptr_array_set_size (ret, self->mirror->len);
-
-      for (guint i = 0; i < ret->len; i++)
+      /* There are no default results to
+       * list from a persisted index
+       */
+      if (snapshot->metas != NULL)
+        groups = NULL;
+
+      for (guint i = 0;
+           groups != NULL && i < groups->len && (limit == 0 || ret->len < limit);
+           i++)
         {
-          GroupData *data = NULL;
+          GroupRecord *record = NULL;
+
+          record = &g_array_index (groups, GroupRecord, i);
+          if ((record->flags & filter) != filter)
+            continue;
 
-          data = g_ptr_array_index (self->mirror, i);
           /* Set original index here to ensure it is always up to date */
-          bz_search_result_set_original_index (data->default_result, i);
-          g_ptr_array_index (ret, i) = g_object_ref (data->default_result);
+          bz_search_result_set_original_index (record->default_result, i);
+          g_ptr_array_add (ret, g_object_ref (record->default_result));
         }
 
       return dex_future_new_take_boxed (
@@ -273,27 +707,167 @@ bz_search_engine_query (BzSearchEngine    *self,
           g_steal_pointer (&ret));
     }
   else
+    return spawn_query_task (self, snapshot, terms, filter, limit, FALSE, cancellable);
+}
+
+/* Like bz_search_engine_query_limited(), except the scores are
+ * handed to `model` once the query completes and results are
+ * only created for the items somebody actually looks at. The
+ * future resolves with the number of matches
+ */
+DexFuture *
+bz_search_engine_query_into (BzSearchEngine      *self,
+                             const char *const   *terms,
+                             BzSearchFilterFlags  filter,
+                             GCancellable        *cancellable,
+                             BzSearchResultModel *model)
+{
+  IndexSnapshotData *snapshot    = NULL;
+  g_autoptr (QueryIntoData) data = NULL;
+  g_autoptr (DexFuture) future   = NULL;
+
+  dex_return_error_if_fail (BZ_IS_SEARCH_ENGINE (self));
+  dex_return_error_if_fail (terms != NULL && *terms != NULL);
+  dex_return_error_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  dex_return_error_if_fail (BZ_IS_SEARCH_RESULT_MODEL (model));
+
+  snapshot = get_active_snapshot (self);
+
+  data           = query_into_data_new ();
+  data->model    = g_object_ref (model);
+  data->snapshot = index_snapshot_data_ref (snapshot);
+  if (cancellable != NULL)
+    data->cancellable = g_object_ref (cancellable);
+
+  if (snapshot->groups->len == 0 || **terms == '\0')
     {
-      g_autoptr (GPtrArray) shallow_mirror = NULL;
-      g_autoptr (QueryTaskData) data       = NULL;
+      g_autoptr (GArray) scores = NULL;
 
-      shallow_mirror = g_ptr_array_new_with_free_func (group_data_unref);
-      g_ptr_array_set_size (shallow_mirror, self->mirror->len);
+      scores = g_array_new (FALSE, FALSE, sizeof (Score));
+      /* There are no default results to
+       * list from a persisted index
+       */
+      for (guint i = 0; snapshot->metas == NULL && i < snapshot->groups->len; i++)
+        {
+          GroupRecord *record = NULL;
+          Score        append = { 0 };
 
-      for (guint i = 0; i < shallow_mirror->len; i++)
-        g_ptr_array_index (shallow_mirror, i) =
-            group_data_ref (g_ptr_array_index (self->mirror, i));
+          record = &g_array_index (snapshot->groups, GroupRecord, i);
+          if ((record->flags & filter) != filter)
+            continue;
 
-      data                 = query_task_data_new ();
-      data->terms          = g_strdupv ((gchar **) terms);
-      data->shallow_mirror = g_steal_pointer (&shallow_mirror);
+          append.idx = i;
+          g_array_append_val (scores, append);
+        }
 
-      return dex_scheduler_spawn (
-          dex_thread_pool_scheduler_get_default (),
-          bz_get_dex_stack_size (),
-          (DexFiberFunc) query_task_fiber,
-          query_task_data_ref (data), query_task_data_unref);
+      future = dex_future_new_take_boxed (G_TYPE_ARRAY, g_steal_pointer (&scores));
+    }
+  else
+    future = spawn_query_task (self, snapshot, terms, filter, 0, TRUE, cancellable);
+
+  future = dex_future_then (
+      future, (DexFutureCallback) query_into_then,
+      query_into_data_ref (data), query_into_data_unref);
+  return g_steal_pointer (&future);
+}
+
+DexFuture *
+bz_search_engine_load_index (BzSearchEngine *self)
+{
+  g_autoptr (LoadTaskData) data = NULL;
+  g_autoptr (DexFuture) future  = NULL;
+
+  dex_return_error_if_fail (BZ_IS_SEARCH_ENGINE (self));
+
+  data       = load_task_data_new ();
+  data->path = dup_index_path ();
+  g_weak_ref_init (&data->engine_wr, self);
+
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) load_task_fiber,
+      load_task_data_ref (data), load_task_data_unref);
+  future = dex_future_then (
+      future, (DexFutureCallback) load_index_then,
+      load_task_data_ref (data), load_task_data_unref);
+  return g_steal_pointer (&future);
+}
+
+DexFuture *
+bz_search_engine_save_index (BzSearchEngine *self)
+{
+  GArray *groups                      = NULL;
+  g_autoptr (GVariantBuilder) builder = NULL;
+  g_autoptr (SaveTaskData) data       = NULL;
+
+  dex_return_error_if_fail (BZ_IS_SEARCH_ENGINE (self));
+
+  /* Save what the model holds now rather than
+   * whatever snapshot happens to be published
+   */
+  if (self->building != NULL)
+    return dex_future_then (
+        dex_ref (self->building),
+        (DexFutureCallback) save_index_then,
+        bz_track_weak (self), bz_weak_release);
+
+  groups = self->snapshot->groups;
+  if (groups->len == 0)
+    return dex_future_new_false ();
+
+  /* Group objects belong to this thread, so the strings
+   * needed to present results are collected up front
+   */
+  builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sssu)"));
+  for (guint i = 0; i < groups->len; i++)
+    {
+      GroupRecord *record      = NULL;
+      const char  *id          = NULL;
+      const char  *title       = NULL;
+      const char  *description = NULL;
+
+      record      = &g_array_index (groups, GroupRecord, i);
+      id          = bz_entry_group_get_id (record->group);
+      title       = bz_entry_group_get_title (record->group);
+      description = bz_entry_group_get_description (record->group);
+
+      g_variant_builder_add (
+          builder, "(sssu)",
+          id != NULL ? id : "",
+          title != NULL ? title : "",
+          description != NULL ? description : "",
+          record->flags);
     }
+
+  data           = save_task_data_new ();
+  data->snapshot = index_snapshot_data_ref (self->snapshot);
+  data->metas    = g_variant_ref_sink (g_variant_builder_end (builder));
+  data->path     = dup_index_path ();
+
+  return dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) save_task_fiber,
+      save_task_data_ref (data), save_task_data_unref);
+}
+
+/* Resolves once queries see the model as it is now.
+ * Changes to the model are indexed in the background
+ */
+DexFuture *
+bz_search_engine_wait_for_index (BzSearchEngine *self)
+{
+  dex_return_error_if_fail (BZ_IS_SEARCH_ENGINE (self));
+
+  if (self->building == NULL)
+    return dex_future_new_true ();
+
+  /* Another change may come in meanwhile */
+  return dex_future_then (
+      dex_ref (self->building),
+      (DexFutureCallback) wait_for_index_then,
+      bz_track_weak (self), bz_weak_release);
 }
 
 static void
@@ -303,8 +877,30 @@ items_changed (BzSearchEngine *self,
                guint           added,
                GListModel     *model)
 {
-  if (removed > 0)
-    g_ptr_array_remove_range (self->mirror, position, removed);
+  g_autoptr (GArray) groups         = NULL;
+  g_autoptr (GByteArray) strings    = NULL;
+  g_autoptr (GArray) chars          = NULL;
+  g_autoptr (GArray) istrings       = NULL;
+  g_autoptr (StringArenaData) arena = NULL;
+  guint first_added                 = 0;
+
+  /* Record arrays are never modified once published, since
+   * running queries may still be reading from them. Only
+   * the records around the changed range are carried over
+   */
+  groups = group_records_new (self->records->len - removed + added);
+  append_group_records (groups, self->records, 0, position);
+  first_added = groups->len;
+
+  if (added == 0)
+    goto done;
+
+  /* All strings of the added groups share one arena,
+   * which lives for as long as any of them is indexed
+   */
+  strings  = g_byte_array_new ();
+  chars    = g_array_new (FALSE, FALSE, sizeof (gunichar));
+  istrings = g_array_new (FALSE, TRUE, sizeof (IndexedStringData));
 
   for (guint i = 0; i < added; i++)
     {
@@ -314,7 +910,7 @@ items_changed (BzSearchEngine *self,
       const char *developer          = NULL;
       const char *description        = NULL;
       GPtrArray  *search_tokens      = NULL;
-      g_autoptr (GroupData) data     = NULL;
+      GroupRecord record             = { 0 };
 
       group         = g_list_model_get_item (model, position + i);
       id            = bz_entry_group_get_id (group);
@@ -323,145 +919,887 @@ items_changed (BzSearchEngine *self,
       description   = bz_entry_group_get_description (group);
       search_tokens = bz_entry_group_get_search_tokens (group);
 
-      data        = group_data_new ();
-      data->group = g_object_ref (group);
-
-      data->istrings = g_array_new (FALSE, TRUE, sizeof (IndexedStringData));
-      g_array_set_clear_func (data->istrings, indexed_string_data_deinit);
+      record.group         = g_object_ref (group);
+      record.first_istring = istrings->len;
+      record.flags         = get_group_flags (group);
 
-#define ADD_INDEXED_STRING(_s, _weight)            \
-  if ((_s) != NULL)                                \
-    {                                              \
-      IndexedStringData append = { 0 };            \
-                                                   \
-      index_string ((_s), &append);                \
-      append.weight = (_weight);                   \
-      g_array_append_val (data->istrings, append); \
-    }
+#define ADD_INDEXED_STRING(_s, _weight) \
+  if ((_s) != NULL)                     \
+    arena_add_string (strings, chars, istrings, (_s), (_weight))
 
       ADD_INDEXED_STRING (id, -1.0);
       ADD_INDEXED_STRING (title, 1.0);
       ADD_INDEXED_STRING (developer, 1.0);
       ADD_INDEXED_STRING (description, -1.0);
 
-#undef ADD_INDEXED_STRING
-
       if (search_tokens != NULL)
         {
-          guint old_len = 0;
+          for (guint j = 0; j < search_tokens->len; j++)
+            ADD_INDEXED_STRING (g_ptr_array_index (search_tokens, j), -1.0);
+        }
 
-          old_len = data->istrings->len;
-          g_array_set_size (data->istrings, old_len + search_tokens->len);
+#undef ADD_INDEXED_STRING
 
-          for (guint j = 0; j < search_tokens->len; j++)
-            {
-              const char        *token   = NULL;
-              IndexedStringData *istring = NULL;
+      record.n_istrings     = istrings->len - record.first_istring;
+      record.default_result = bz_search_result_new ();
+      bz_search_result_set_group (record.default_result, group);
 
-              token   = g_ptr_array_index (search_tokens, j);
-              istring = &g_array_index (data->istrings, IndexedStringData, old_len + j);
+      g_array_append_val (groups, record);
+    }
 
-              index_string (token, istring);
-              istring->weight = -1.0;
-            }
-        }
+  arena = string_arena_new_take (
+      g_steal_pointer (&strings),
+      g_steal_pointer (&chars),
+      g_steal_pointer (&istrings));
+  for (guint i = first_added; i < groups->len; i++)
+    g_array_index (groups, GroupRecord, i).arena = string_arena_data_ref (arena);
 
-      data->default_result = bz_search_result_new ();
-      bz_search_result_set_group (data->default_result, group);
+done:
+  append_group_records (
+      groups, self->records,
+      position + removed,
+      self->records->len - position - removed);
 
-      g_ptr_array_insert (self->mirror, position + i, g_steal_pointer (&data));
-    }
+  rebuild_snapshot (self, g_steal_pointer (&groups));
+}
+
+/* Takes over `groups` as the records of the model and
+ * builds their snapshot on the thread pool
+ */
+static void
+rebuild_snapshot (BzSearchEngine *self,
+                  GArray         *groups)
+{
+  g_autoptr (BuildTaskData) data = NULL;
+  g_autoptr (DexFuture) future   = NULL;
+
+  g_clear_pointer (&self->records, g_array_unref);
+  self->records = groups;
+
+  data             = build_task_data_new ();
+  data->groups     = g_array_ref (groups);
+  data->generation = ++self->build_generation;
+  g_weak_ref_init (&data->engine_wr, self);
+
+  future = dex_scheduler_spawn (
+      dex_thread_pool_scheduler_get_default (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) build_task_fiber,
+      build_task_data_ref (data), build_task_data_unref);
+  future = dex_future_then (
+      future, (DexFutureCallback) build_snapshot_then,
+      build_task_data_ref (data), build_task_data_unref);
+
+  dex_clear (&self->building);
+  self->building = g_steal_pointer (&future);
 }
 
 static DexFuture *
-query_task_fiber (QueryTaskData *data)
+build_task_fiber (BuildTaskData *data)
 {
-  char     **terms                            = data->terms;
-  GPtrArray *shallow_mirror                   = data->shallow_mirror;
-  g_autoptr (GError) local_error              = NULL;
-  gboolean         result                     = FALSE;
-  g_autofree char *joined                     = NULL;
-  double           threshold                  = 0.0;
-  g_autoptr (IndexedStringData) query_istring = NULL;
-  guint n_sub_tasks                           = 0;
-  guint scores_per_task                       = 0;
-  g_autoptr (GPtrArray) sub_futures           = NULL;
-  g_autoptr (GArray) scores                   = NULL;
-  g_autoptr (GPtrArray) results               = NULL;
+  data->snapshot = index_snapshot_new_take (g_array_ref (data->groups));
+  return dex_future_new_true ();
+}
 
-  joined = g_strjoinv (" ", terms);
-  // threshold = (double) strlen (joined) / (double) g_strv_length (terms);
-  threshold = (double) strlen (joined);
+static DexFuture *
+build_snapshot_then (DexFuture     *future,
+                     BuildTaskData *data)
+{
+  g_autoptr (BzSearchEngine) self = NULL;
 
-  query_istring = indexed_string_data_new ();
-  index_string (joined, query_istring);
+  bz_weak_get_or_return_reject (self, &data->engine_wr);
 
-  n_sub_tasks     = MAX (1, MIN (shallow_mirror->len / 512, g_get_num_processors ()));
-  scores_per_task = shallow_mirror->len / n_sub_tasks;
+  /* A later change is being built already */
+  if (data->generation != self->build_generation)
+    return dex_future_new_false ();
 
-  sub_futures = g_ptr_array_new_with_free_func (dex_unref);
-  for (guint i = 0; i < n_sub_tasks; i++)
-    {
-      g_autoptr (QuerySubTaskData) sub_data = NULL;
-      g_autoptr (DexFuture) future          = NULL;
+  g_clear_pointer (&self->snapshot, index_snapshot_data_unref);
+  self->snapshot = index_snapshot_data_ref (data->snapshot);
+  dex_clear (&self->building);
 
-      sub_data                 = query_sub_task_data_new ();
-      sub_data->query_istring  = indexed_string_data_ref (query_istring);
-      sub_data->shallow_mirror = g_ptr_array_ref (shallow_mirror);
-      sub_data->threshold      = threshold;
-      sub_data->work_offset    = i * scores_per_task;
-      sub_data->work_length    = scores_per_task;
+  /* The live index supersedes the persisted one for good */
+  if (self->snapshot->groups->len > 0)
+    g_clear_pointer (&self->persisted, index_snapshot_data_unref);
 
-      if (i >= n_sub_tasks - 1)
-        sub_data->work_length += shallow_mirror->len % n_sub_tasks;
+  /* Cached scores refer to the old indices */
+  invalidate_query_cache (self->cache);
 
-      future = dex_scheduler_spawn (
-          dex_thread_pool_scheduler_get_default (),
-          bz_get_dex_stack_size (),
-          (DexFiberFunc) query_sub_task_fiber,
-          query_sub_task_data_ref (sub_data),
-          query_sub_task_data_unref);
+  return dex_future_new_true ();
+}
 
-      g_ptr_array_add (sub_futures, g_steal_pointer (&future));
-    }
+static DexFuture *
+wait_for_index_then (DexFuture *future,
+                     GWeakRef  *wr)
+{
+  g_autoptr (BzSearchEngine) self = NULL;
 
-  result = dex_await (dex_future_allv (
-                          (DexFuture *const *) sub_futures->pdata, sub_futures->len),
-                      &local_error);
-  if (!result)
-    return dex_future_new_for_error (g_steal_pointer (&local_error));
+  bz_weak_get_or_return_reject (self, wr);
+  return bz_search_engine_wait_for_index (self);
+}
 
-  scores = g_array_new (FALSE, FALSE, sizeof (Score));
-  for (guint i = 0; i < sub_futures->len; i++)
-    {
-      DexFuture *future     = NULL;
-      GArray    *scores_out = NULL;
+static DexFuture *
+save_index_then (DexFuture *future,
+                 GWeakRef  *wr)
+{
+  g_autoptr (BzSearchEngine) self = NULL;
 
-      future     = g_ptr_array_index (sub_futures, i);
-      scores_out = g_value_get_boxed (dex_future_get_value (future, NULL));
+  bz_weak_get_or_return_reject (self, wr);
+  return bz_search_engine_save_index (self);
+}
 
-      if (scores_out->len > 0)
+static GramIndexData *
+build_gram_index (GArray *groups)
+{
+  g_autoptr (GramIndexData) grams = NULL;
+
+  grams           = gram_index_data_new ();
+  grams->postings = g_hash_table_new_full (
+      g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_array_unref);
+
+  for (guint i = 0; i < groups->len; i++)
+    {
+      GroupRecord *record = NULL;
+
+      record = &g_array_index (groups, GroupRecord, i);
+      for (guint j = 0; j < record->n_istrings; j++)
+        {
+          IndexedStringData *istring = NULL;
+
+          istring = &record->arena->istrings[record->first_istring + j];
+          for (glong k = 0; k + GRAM_LENGTH <= istring->utf8_len; k++)
+            {
+              guint   gram    = 0;
+              GArray *posting = NULL;
+
+              gram    = make_gram (istring, k);
+              posting = g_hash_table_lookup (grams->postings, GUINT_TO_POINTER (gram));
+              if (posting == NULL)
+                {
+                  posting = g_array_new (FALSE, FALSE, sizeof (guint));
+                  g_hash_table_replace (grams->postings, GUINT_TO_POINTER (gram), posting);
+                }
+
+              /* Groups are visited in order, so any
+               * duplicate would be the last element
+               */
+              if (posting->len == 0 ||
+                  g_array_index (posting, guint, posting->len - 1) != i)
+                g_array_append_val (posting, i);
+            }
+        }
+    }
+
+  return g_steal_pointer (&grams);
+}
+
+static GArray *
+collect_candidates (GramIndexData     *grams,
+                    IndexedStringData *query_istring,
+                    guint              n_groups)
+{
+  g_autofree guint8 *hits       = NULL;
+  g_autoptr (GArray) candidates = NULL;
+
+  hits = g_malloc0 (n_groups);
+  for (glong i = 0; i + GRAM_LENGTH <= query_istring->utf8_len; i++)
+    {
+      guint   gram    = 0;
+      GArray *posting = NULL;
+
+      gram    = make_gram (query_istring, i);
+      posting = g_hash_table_lookup (grams->postings, GUINT_TO_POINTER (gram));
+      if (posting == NULL)
+        continue;
+
+      for (guint j = 0; j < posting->len; j++)
+        hits[g_array_index (posting, guint, j)] = 1;
+    }
+
+  candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  for (guint i = 0; i < n_groups; i++)
+    {
+      if (hits[i])
+        g_array_append_val (candidates, i);
+    }
+
+  return g_steal_pointer (&candidates);
+}
+
+/* Keeps the groups of `candidates`, or of every group
+ * if it is NULL, which satisfy all the flags in `filter`
+ */
+static GArray *
+filter_candidates (GArray *groups,
+                   GArray *candidates,
+                   guint   filter)
+{
+  g_autoptr (GArray) filtered = NULL;
+  guint n_candidates          = 0;
+
+  n_candidates = candidates != NULL ? candidates->len : groups->len;
+  filtered     = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_candidates);
+
+  for (guint i = 0; i < n_candidates; i++)
+    {
+      guint        idx    = 0;
+      GroupRecord *record = NULL;
+
+      idx    = candidates != NULL ? g_array_index (candidates, guint, i) : i;
+      record = &g_array_index (groups, GroupRecord, idx);
+      if ((record->flags & filter) == filter)
+        g_array_append_val (filtered, idx);
+    }
+
+  return g_steal_pointer (&filtered);
+}
+
+static TypoIndexData *
+build_typo_index (GArray *groups)
+{
+  g_autoptr (TypoIndexData) typos      = NULL;
+  g_autoptr (GHashTable) words_by_text = NULL;
+
+  typos              = typo_index_data_new ();
+  typos->words       = g_ptr_array_new_with_free_func (g_free);
+  typos->word_groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+  typos->deletes     = g_hash_table_new_full (
+      g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_array_unref);
+
+  /* word -> word id, the keys are owned by `typos->words` */
+  words_by_text = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (guint i = 0; i < groups->len; i++)
+    {
+      GroupRecord *record = NULL;
+
+      record = &g_array_index (groups, GroupRecord, i);
+      for (guint j = 0; j < record->n_istrings; j++)
+        {
+          IndexedStringData *istring  = NULL;
+          g_autoptr (GPtrArray) words = NULL;
+
+          /* Only titles and developers carry a weight */
+          istring = &record->arena->istrings[record->first_istring + j];
+          if (istring->weight <= 0.0)
+            continue;
+
+          words = split_words (istring->ptr);
+          for (guint k = 0; k < words->len; k++)
+            {
+              char    *word        = NULL;
+              gpointer value       = NULL;
+              guint    word_id     = 0;
+              GArray  *word_groups = NULL;
+
+              word = g_ptr_array_index (words, k);
+              if (g_hash_table_lookup_extended (words_by_text, word, NULL, &value))
+                word_id = GPOINTER_TO_UINT (value);
+              else
+                {
+                  g_autofree gunichar *chars = NULL;
+                  glong                len   = 0;
+                  g_autoptr (GArray) hashes  = NULL;
+
+                  chars = g_utf8_to_ucs4_fast (word, -1, &len);
+                  if (len < MIN_TYPO_WORD_LENGTH)
+                    continue;
+
+                  word_id = typos->words->len;
+                  g_ptr_array_add (typos->words, g_strdup (word));
+                  g_ptr_array_add (typos->word_groups, g_array_new (FALSE, FALSE, sizeof (guint)));
+                  g_hash_table_replace (
+                      words_by_text,
+                      g_ptr_array_index (typos->words, word_id),
+                      GUINT_TO_POINTER (word_id));
+
+                  hashes = collect_deletes (chars, MIN (len, TYPO_PREFIX_LENGTH), MAX_TYPO_DISTANCE);
+                  for (guint l = 0; l < hashes->len; l++)
+                    {
+                      guint   hash    = 0;
+                      GArray *posting = NULL;
+
+                      hash    = g_array_index (hashes, guint, l);
+                      posting = g_hash_table_lookup (typos->deletes, GUINT_TO_POINTER (hash));
+                      if (posting == NULL)
+                        {
+                          posting = g_array_new (FALSE, FALSE, sizeof (guint));
+                          g_hash_table_replace (typos->deletes, GUINT_TO_POINTER (hash), posting);
+                        }
+                      g_array_append_val (posting, word_id);
+                    }
+                }
+
+              /* Groups are visited in order, so any
+               * duplicate would be the last element
+               */
+              word_groups = g_ptr_array_index (typos->word_groups, word_id);
+              if (word_groups->len == 0 ||
+                  g_array_index (word_groups, guint, word_groups->len - 1) != i)
+                g_array_append_val (word_groups, i);
+            }
+        }
+    }
+
+  return g_steal_pointer (&typos);
+}
+
+/* Returns the score every group earns from words of the query
+ * which look like misspellings of its title or developer words,
+ * or NULL if there are none. Words the query spells out fully
+ * are left to the regular scorer
+ */
+static GArray *
+collect_typo_scores (TypoIndexData     *typos,
+                     IndexedStringData *query_istring,
+                     double             threshold,
+                     guint              n_groups)
+{
+  g_autoptr (GPtrArray) terms  = NULL;
+  g_autoptr (GArray) scores    = NULL;
+  g_autoptr (GHashTable) tried = NULL;
+  gboolean any                 = FALSE;
+
+  terms = split_words (query_istring->ptr);
+  if (terms->len == 0)
+    return NULL;
+
+  scores = g_array_sized_new (FALSE, TRUE, sizeof (double), n_groups);
+  g_array_set_size (scores, n_groups);
+  tried = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (guint i = 0; i < terms->len; i++)
+    {
+      const char *term               = NULL;
+      g_autofree gunichar *chars     = NULL;
+      glong                len       = 0;
+      guint                max_edits = 0;
+      guint                prefix    = 0;
+      g_autoptr (GArray) hashes      = NULL;
+
+      term  = g_ptr_array_index (terms, i);
+      chars = g_utf8_to_ucs4_fast (term, -1, &len);
+      if (len < MIN_TYPO_WORD_LENGTH)
+        continue;
+
+      /* Short words allow for fewer edits,
+       * or they would match nearly anything
+       */
+      max_edits = len < 5 ? 1 : MAX_TYPO_DISTANCE;
+      prefix    = MIN (len, TYPO_PREFIX_LENGTH);
+      hashes    = collect_deletes (chars, prefix, max_edits);
+
+      g_hash_table_remove_all (tried);
+      for (guint j = 0; j < hashes->len; j++)
+        {
+          GArray *posting = NULL;
+
+          posting = g_hash_table_lookup (
+              typos->deletes,
+              GUINT_TO_POINTER (g_array_index (hashes, guint, j)));
+          if (posting == NULL)
+            continue;
+
+          for (guint k = 0; k < posting->len; k++)
+            {
+              guint                word_id     = 0;
+              const char          *word        = NULL;
+              g_autofree gunichar *word_chars  = NULL;
+              glong                word_len    = 0;
+              guint                distance    = 0;
+              double               score       = 0.0;
+              GArray              *word_groups = NULL;
+
+              word_id = g_array_index (posting, guint, k);
+              if (!g_hash_table_add (tried, GUINT_TO_POINTER (word_id)))
+                continue;
+
+              word = g_ptr_array_index (typos->words, word_id);
+              if (strstr (word, term) != NULL)
+                continue;
+
+              /* Variants only tell us the leading characters are
+               * close, and hashes may collide, so the whole words
+               * are checked for real
+               */
+              word_chars = g_utf8_to_ucs4_fast (word, -1, &word_len);
+              if ((guint) ABS (len - word_len) > max_edits)
+                continue;
+              distance = osa_distance (chars, len, word_chars, word_len);
+              if (distance > max_edits)
+                continue;
+
+              score = threshold *
+                      (1.0 + ((double) len / (double) MAX (len, word_len))) *
+                      (1.0 - TYPO_EDIT_PENALTY * distance);
+
+              word_groups = g_ptr_array_index (typos->word_groups, word_id);
+              for (guint l = 0; l < word_groups->len; l++)
+                {
+                  double *group_score = NULL;
+
+                  group_score  = &g_array_index (scores, double, g_array_index (word_groups, guint, l));
+                  *group_score = MAX (*group_score, score);
+                }
+              any = TRUE;
+            }
+        }
+    }
+
+  return any ? g_steal_pointer (&scores) : NULL;
+}
+
+/* Adds every group with a typo score to the sorted `candidates` */
+static GArray *
+merge_typo_candidates (GArray *candidates,
+                       GArray *typo_scores)
+{
+  g_autofree guint8 *hits   = NULL;
+  g_autoptr (GArray) merged = NULL;
+
+  hits = g_malloc0 (typo_scores->len);
+  for (guint i = 0; i < candidates->len; i++)
+    hits[g_array_index (candidates, guint, i)] = 1;
+  for (guint i = 0; i < typo_scores->len; i++)
+    {
+      if (g_array_index (typo_scores, double, i) > 0.0)
+        hits[i] = 1;
+    }
+
+  merged = g_array_new (FALSE, FALSE, sizeof (guint));
+  for (guint i = 0; i < typo_scores->len; i++)
+    {
+      if (hits[i])
+        g_array_append_val (merged, i);
+    }
+
+  return g_steal_pointer (&merged);
+}
+
+/* Splits a normalized string into its runs of
+ * letters and digits
+ */
+static GPtrArray *
+split_words (const char *s)
+{
+  g_autoptr (GPtrArray) words = NULL;
+  const char *start           = NULL;
+
+  words = g_ptr_array_new_with_free_func (g_free);
+  for (const char *ch = s;; ch = g_utf8_next_char (ch))
+    {
+      gboolean is_word = FALSE;
+
+      is_word = *ch != '\0' && g_unichar_isalnum (g_utf8_get_char (ch));
+      if (is_word && start == NULL)
+        start = ch;
+      else if (!is_word && start != NULL)
+        {
+          g_ptr_array_add (words, g_strndup (start, ch - start));
+          start = NULL;
+        }
+
+      if (*ch == '\0')
+        break;
+    }
+
+  return g_steal_pointer (&words);
+}
+
+static void
+append_deletes (GArray         *hashes,
+                const gunichar *chars,
+                guint           len,
+                guint           distance)
+{
+  guint64 hash = 0;
+  guint   key  = 0;
+
+  hash = hash_bytes (FNV_OFFSET_BASIS, chars, len * sizeof (gunichar));
+  key  = (guint) (hash ^ (hash >> 32));
+  g_array_append_val (hashes, key);
+
+  if (distance == 0 || len <= 1)
+    return;
+
+  for (guint i = 0; i < len; i++)
+    {
+      gunichar variant[TYPO_PREFIX_LENGTH] = { 0 };
+
+      memcpy (variant, chars, i * sizeof (gunichar));
+      memcpy (variant + i, chars + i + 1, (len - i - 1) * sizeof (gunichar));
+      append_deletes (hashes, variant, len - 1, distance - 1);
+    }
+}
+
+/* Returns the sorted hashes of `chars` and of every variant
+ * of it with up to `distance` characters deleted
+ */
+static GArray *
+collect_deletes (const gunichar *chars,
+                 guint           len,
+                 guint           distance)
+{
+  g_autoptr (GArray) hashes = NULL;
+  guint n_unique            = 0;
+
+  hashes = g_array_new (FALSE, FALSE, sizeof (guint));
+  append_deletes (hashes, chars, len, distance);
+
+  /* Deleting the same characters in a different
+   * order yields the same variant more than once
+   */
+  g_array_sort (hashes, (GCompareFunc) cmp_indices);
+  for (guint i = 0; i < hashes->len; i++)
+    {
+      if (n_unique == 0 ||
+          g_array_index (hashes, guint, i) != g_array_index (hashes, guint, n_unique - 1))
+        g_array_index (hashes, guint, n_unique++) = g_array_index (hashes, guint, i);
+    }
+  g_array_set_size (hashes, n_unique);
+
+  return g_steal_pointer (&hashes);
+}
+
+/* Optimal string alignment distance, which is the Levenshtein
+ * distance where swapping two neighbours counts as one edit.
+ * Only the last three rows of the table are kept around
+ */
+static guint
+osa_distance (const gunichar *a,
+              guint           a_len,
+              const gunichar *b,
+              guint           b_len)
+{
+  g_autofree guint *rows   = NULL;
+  guint            *before = NULL;
+  guint            *prev   = NULL;
+  guint            *cur    = NULL;
+
+  rows   = g_new0 (guint, 3 * (b_len + 1));
+  before = rows;
+  prev   = rows + (b_len + 1);
+  cur    = rows + 2 * (b_len + 1);
+
+  for (guint j = 0; j <= b_len; j++)
+    cur[j] = j;
+
+  for (guint i = 1; i <= a_len; i++)
+    {
+      guint *oldest = before;
+
+      /* Rows i - 2 and i - 1, the oldest is reused for row i */
+      before = prev;
+      prev   = cur;
+      cur    = oldest;
+
+      cur[0] = i;
+      for (guint j = 1; j <= b_len; j++)
+        {
+          guint cost = 0;
+          guint min  = 0;
+
+          cost = a[i - 1] == b[j - 1] ? 0 : 1;
+          min  = MIN (prev[j] + 1, cur[j - 1] + 1);
+          min  = MIN (min, prev[j - 1] + cost);
+          if (i > 1 && j > 1 &&
+              a[i - 1] == b[j - 2] &&
+              a[i - 2] == b[j - 1])
+            min = MIN (min, before[j - 2] + 1);
+
+          cur[j] = min;
+        }
+    }
+
+  return cur[b_len];
+}
+
+static inline guint
+get_group_flags (BzEntryGroup *group)
+{
+  guint flags = BZ_SEARCH_FILTER_NONE;
+
+  if (bz_entry_group_get_is_floss (group))
+    flags |= BZ_SEARCH_FILTER_FOSS;
+  if (bz_entry_group_get_is_flathub (group))
+    flags |= BZ_SEARCH_FILTER_FLATHUB;
+
+  return flags;
+}
+
+static DexFuture *
+spawn_query_task (BzSearchEngine    *self,
+                  IndexSnapshotData *snapshot,
+                  const char *const *terms,
+                  guint              filter,
+                  guint              limit,
+                  gboolean           lazy,
+                  GCancellable      *cancellable)
+{
+  g_autoptr (QueryTaskData) data = NULL;
+
+  data             = query_task_data_new ();
+  data->terms      = g_strdupv ((gchar **) terms);
+  data->snapshot   = index_snapshot_data_ref (snapshot);
+  data->cache      = query_cache_data_ref (self->cache);
+  data->generation = self->cache->generation;
+  data->filter     = filter;
+  data->limit      = limit;
+  data->lazy       = lazy;
+  if (cancellable != NULL)
+    data->cancellable = g_object_ref (cancellable);
+
+  return dex_scheduler_spawn (
+      dex_thread_pool_scheduler_get_default (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) query_task_fiber,
+      query_task_data_ref (data), query_task_data_unref);
+}
+
+static DexFuture *
+query_into_then (DexFuture     *future,
+                 QueryIntoData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  GArray *scores                 = NULL;
+
+  /* A newer query may already own the model */
+  if (g_cancellable_set_error_if_cancelled (data->cancellable, &local_error))
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  scores = g_value_get_boxed (dex_future_get_value (future, NULL));
+  bz_search_result_model_set_scores (
+      data->model,
+      scores,
+      (BzSearchResultFillFunc) fill_search_result,
+      index_snapshot_data_ref (data->snapshot),
+      (GDestroyNotify) index_snapshot_data_unref);
+
+  return dex_future_new_for_uint (scores->len);
+}
+
+static void
+fill_search_result (BzSearchResult    *result,
+                    const Score       *score,
+                    IndexSnapshotData *snapshot)
+{
+  GroupRecord *record = NULL;
+
+  record = &g_array_index (snapshot->groups, GroupRecord, score->idx);
+  if (record->group != NULL)
+    {
+      bz_search_result_set_group (result, record->group);
+      bz_search_result_set_id (result, NULL);
+      bz_search_result_set_title (result, NULL);
+      bz_search_result_set_description (result, NULL);
+    }
+  else
+    {
+      const char *id          = NULL;
+      const char *title       = NULL;
+      const char *description = NULL;
+
+      g_variant_get_child (
+          snapshot->metas, score->idx, "(&s&s&su)",
+          &id, &title, &description, NULL);
+      bz_search_result_set_group (result, NULL);
+      bz_search_result_set_id (result, id);
+      bz_search_result_set_title (result, title);
+      bz_search_result_set_description (result, *description != '\0' ? description : NULL);
+    }
+  bz_search_result_set_title_markup (result, NULL);
+  bz_search_result_set_original_index (result, score->idx);
+  bz_search_result_set_score (result, score->val);
+}
+
+static DexFuture *
+query_task_fiber (QueryTaskData *data)
+{
+  char             **terms                    = data->terms;
+  IndexSnapshotData *snapshot                 = data->snapshot;
+  GArray            *groups                   = data->snapshot->groups;
+  QueryCacheData    *cache                    = data->cache;
+  GCancellable      *cancellable              = data->cancellable;
+  guint              generation               = data->generation;
+  guint              filter                   = data->filter;
+  guint              limit                    = data->limit;
+  g_autoptr (GError) local_error              = NULL;
+  gboolean         result                     = FALSE;
+  g_autofree char *joined                     = NULL;
+  double           threshold                  = 0.0;
+  g_autoptr (IndexedStringData) query_istring = NULL;
+  g_autoptr (GArray) cached_scores            = NULL;
+  gboolean exact                              = FALSE;
+  g_autoptr (GArray) candidates               = NULL;
+  g_autoptr (GArray) typo_scores              = NULL;
+  guint n_work                                = 0;
+  guint n_sub_tasks                           = 0;
+  g_autoptr (QuerySubTaskData) sub_data       = NULL;
+  g_autoptr (GPtrArray) sub_futures           = NULL;
+  g_autoptr (GArray) scores                   = NULL;
+  guint n_results                             = 0;
+  g_autoptr (GPtrArray) results               = NULL;
+
+  joined = g_strjoinv (" ", terms);
+  // threshold = (double) strlen (joined) / (double) g_strv_length (terms);
+  threshold = (double) strlen (joined);
+
+  query_istring = indexed_string_data_new ();
+  index_string (joined, query_istring);
+
+  cached_scores = query_cache_lookup (cache, generation, query_istring->ptr, filter, &exact);
+  if (cached_scores != NULL && exact)
+    {
+      scores = g_steal_pointer (&cached_scores);
+      goto done;
+    }
+
+  if (cached_scores != NULL)
+    {
+      /* The new query extends one we have already scored, so
+       * only the groups which survived that one are considered
+       */
+      candidates = g_array_sized_new (FALSE, FALSE, sizeof (guint), cached_scores->len);
+      for (guint i = 0; i < cached_scores->len; i++)
+        g_array_append_val (candidates, g_array_index (cached_scores, Score, i).idx);
+      g_array_sort (candidates, (GCompareFunc) cmp_indices);
+      n_work = candidates->len;
+    }
+  /* Only groups sharing at least one gram with the query
+   * need to be scored. Shorter queries have no grams, so
+   * they still have to consider every group
+   */
+  else if (snapshot->grams != NULL && query_istring->utf8_len >= GRAM_LENGTH)
+    {
+      candidates = collect_candidates (snapshot->grams, query_istring, groups->len);
+      n_work     = candidates->len;
+    }
+  else
+    n_work = groups->len;
+
+  /* Misspelled words share few grams with the words they
+   * were meant to be, so their groups are added back here
+   */
+  if (snapshot->typos != NULL)
+    typo_scores = collect_typo_scores (snapshot->typos, query_istring, threshold, groups->len);
+  if (typo_scores != NULL && candidates != NULL)
+    {
+      GArray *merged = NULL;
+
+      merged = merge_typo_candidates (candidates, typo_scores);
+      g_clear_pointer (&candidates, g_array_unref);
+      candidates = merged;
+      n_work     = candidates->len;
+    }
+
+  /* Groups excluded by the filter are dropped
+   * before anything is spent on scoring them
+   */
+  if (filter != BZ_SEARCH_FILTER_NONE)
+    {
+      GArray *filtered = NULL;
+
+      filtered = filter_candidates (groups, candidates, filter);
+      g_clear_pointer (&candidates, g_array_unref);
+      candidates = filtered;
+      n_work     = candidates->len;
+    }
+
+  scores = g_array_new (FALSE, FALSE, sizeof (Score));
+  if (n_work == 0)
+    goto store;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  n_sub_tasks = MAX (1, MIN (n_work / 512, g_get_num_processors ()));
+
+  sub_data                = query_sub_task_data_new ();
+  sub_data->query_istring = indexed_string_data_ref (query_istring);
+  sub_data->snapshot      = index_snapshot_data_ref (snapshot);
+  if (candidates != NULL)
+    sub_data->candidates = g_array_ref (candidates);
+  if (typo_scores != NULL)
+    sub_data->typo_scores = g_array_ref (typo_scores);
+  if (cancellable != NULL)
+    sub_data->cancellable = g_object_ref (cancellable);
+  sub_data->threshold = threshold;
+  sub_data->n_work    = n_work;
+  sub_data->limit     = limit;
+
+  sub_futures = g_ptr_array_new_with_free_func (dex_unref);
+  for (guint i = 0; i < n_sub_tasks; i++)
+    {
+      g_autoptr (DexFuture) future = NULL;
+
+      future = dex_scheduler_spawn (
+          dex_thread_pool_scheduler_get_default (),
+          bz_get_dex_stack_size (),
+          (DexFiberFunc) query_sub_task_fiber,
+          query_sub_task_data_ref (sub_data),
+          query_sub_task_data_unref);
+
+      g_ptr_array_add (sub_futures, g_steal_pointer (&future));
+    }
+
+  result = dex_await (dex_future_allv (
+                          (DexFuture *const *) sub_futures->pdata, sub_futures->len),
+                      &local_error);
+  if (!result)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  for (guint i = 0; i < sub_futures->len; i++)
+    {
+      DexFuture *future     = NULL;
+      GArray    *scores_out = NULL;
+
+      future     = g_ptr_array_index (sub_futures, i);
+      scores_out = g_value_get_boxed (dex_future_get_value (future, NULL));
+
+      if (scores_out->len > 0)
         g_array_append_vals (scores, scores_out->data, scores_out->len);
     }
   if (scores->len > 0)
     g_array_sort (scores, (GCompareFunc) cmp_scores);
 
+store:
+  /* A limited query only knows about its best matches,
+   * which is not enough to narrow down a later refinement
+   */
+  if (limit == 0)
+    query_cache_store (cache, generation, query_istring->ptr, filter, scores);
+
+done:
+  n_results = limit > 0 ? MIN (limit, scores->len) : scores->len;
+
+  /* Scores from the cache are shared, so
+   * they are never trimmed in place
+   */
+  if (data->lazy)
+    {
+      if (n_results < scores->len)
+        {
+          GArray *trimmed = NULL;
+
+          trimmed = g_array_sized_new (FALSE, FALSE, sizeof (Score), n_results);
+          g_array_append_vals (trimmed, scores->data, n_results);
+          g_clear_pointer (&scores, g_array_unref);
+          scores = trimmed;
+        }
+      return dex_future_new_take_boxed (
+          G_TYPE_ARRAY,
+          g_steal_pointer (&scores));
+    }
+
   results = g_ptr_array_new_with_free_func (g_object_unref);
-  g_ptr_array_set_size (results, scores->len);
-  for (guint i = 0; i < scores->len; i++)
+  g_ptr_array_set_size (results, n_results);
+  for (guint i = 0; i < n_results; i++)
     {
-      Score     *score                   = NULL;
-      GroupData *group_data              = NULL;
       g_autoptr (BzSearchResult) sresult = NULL;
 
-      score      = &g_array_index (scores, Score, i);
-      group_data = g_ptr_array_index (shallow_mirror, score->idx);
-
       sresult = bz_search_result_new ();
-      bz_search_result_set_group (sresult, group_data->group);
-      bz_search_result_set_original_index (sresult, score->idx);
-      bz_search_result_set_score (sresult, score->val);
-
+      fill_search_result (sresult, &g_array_index (scores, Score, i), snapshot);
       g_ptr_array_index (results, i) = g_steal_pointer (&sresult);
     }
 
@@ -473,174 +1811,296 @@ query_task_fiber (QueryTaskData *data)
 static DexFuture *
 query_sub_task_fiber (QuerySubTaskData *data)
 {
-  GPtrArray         *shallow_mirror = data->shallow_mirror;
+  GArray            *groups         = data->snapshot->groups;
   IndexedStringData *query_istring  = data->query_istring;
+  GArray            *candidates     = data->candidates;
+  GArray            *typo_scores    = data->typo_scores;
+  GCancellable      *cancellable    = data->cancellable;
   double             threshold      = data->threshold;
-  guint              work_offset    = data->work_offset;
-  guint              work_length    = data->work_length;
+  guint              n_work         = data->n_work;
+  guint              limit          = data->limit;
+  g_autoptr (GError) local_error    = NULL;
   g_autoptr (GArray) scores_out     = NULL;
 
   scores_out = g_array_new (FALSE, FALSE, sizeof (Score));
 
-  for (guint i = 0; i < work_length; i++)
+  for (;;)
     {
-      GroupData *group_data = NULL;
-      double     score      = 0.0;
+      guint start = 0;
+      guint end   = 0;
 
-      group_data = g_ptr_array_index (shallow_mirror, work_offset + i);
-      for (guint j = 0; j < group_data->istrings->len; j++)
-        {
-          IndexedStringData *token_istring = NULL;
-          double             token_score   = 0.0;
+      /* A newer query has superseded this one */
+      if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
+        return dex_future_new_for_error (g_steal_pointer (&local_error));
 
-          token_istring = &g_array_index (group_data->istrings, IndexedStringData, j);
-          if (strstr (token_istring->ptr, query_istring->ptr) != NULL)
-            token_score = threshold * (1.0 + ((double) query_istring->utf8_len /
-                                              (double) token_istring->utf8_len));
-          else if (token_istring->weight > 0.0)
-            token_score = test_strings (query_istring, token_istring);
+      start = g_atomic_int_add (&data->next_chunk, WORK_CHUNK_LENGTH);
+      if (start >= n_work)
+        break;
+      end = MIN (start + WORK_CHUNK_LENGTH, n_work);
 
-          if (token_istring->weight > 0.0)
-            token_score *= token_istring->weight;
+      for (guint i = start; i < end; i++)
+        {
+          guint  idx   = 0;
+          double score = 0.0;
 
-          score += token_score;
-        }
+          idx   = candidates != NULL ? g_array_index (candidates, guint, i) : i;
+          score = score_group (&g_array_index (groups, GroupRecord, idx),
+                               query_istring, threshold);
+          if (typo_scores != NULL)
+            score += g_array_index (typo_scores, double, idx);
 
-      if (score > threshold)
-        {
-          Score append = { 0 };
+          if (score > threshold)
+            {
+              Score append = { 0 };
 
-          append.idx = work_offset + i;
-          append.val = score;
-          g_array_append_val (scores_out, append);
+              append.idx = idx;
+              append.val = score;
+
+              if (limit > 0)
+                score_heap_push (scores_out, limit, &append);
+              else
+                g_array_append_val (scores_out, append);
+            }
         }
     }
 
   return dex_future_new_take_boxed (G_TYPE_ARRAY, g_steal_pointer (&scores_out));
 }
 
-static inline void
-index_string (const char        *s,
-              IndexedStringData *out)
+static inline double
+score_group (GroupRecord       *record,
+             IndexedStringData *query_istring,
+             double             threshold)
+{
+  IndexedStringData *istrings = NULL;
+  double             score    = 0.0;
+
+  istrings = record->arena->istrings + record->first_istring;
+  for (guint i = 0; i < record->n_istrings; i++)
+    {
+      IndexedStringData *token_istring = NULL;
+      double             token_score   = 0.0;
+
+      token_istring = &istrings[i];
+      if (strstr (token_istring->ptr, query_istring->ptr) != NULL)
+        token_score = threshold * (1.0 + ((double) query_istring->utf8_len /
+                                          (double) token_istring->utf8_len));
+      else if (token_istring->weight > 0.0)
+        token_score = test_strings (query_istring, token_istring);
+
+      if (token_istring->weight > 0.0)
+        token_score *= token_istring->weight;
+
+      score += token_score;
+    }
+
+  return score;
+}
+
+static inline char *
+normalize_string (const char *s)
 {
   g_autofree char *normalized = NULL;
-  g_autofree char *casefolded = NULL;
-  guint            i          = 0;
 
   normalized = g_utf8_normalize (s, -1, G_NORMALIZE_ALL);
-  casefolded = g_utf8_casefold (normalized, -1);
+  return g_utf8_casefold (normalized, -1);
+}
+
+static inline void
+index_string (const char        *s,
+              IndexedStringData *out)
+{
+  guint i = 0;
 
-  out->ptr      = g_steal_pointer (&casefolded);
+  out->ptr      = normalize_string (s);
   out->utf8_len = g_utf8_strlen (out->ptr, -1);
-  out->chars    = g_malloc0_n (out->utf8_len, sizeof (*out->chars));
 
+  /* Pure ASCII strings are matched directly off of their bytes */
+  if ((glong) strlen (out->ptr) == out->utf8_len)
+    return;
+
+  out->chars = g_new (gunichar, out->utf8_len);
   for (char *ch = out->ptr; *ch != '\0'; ch = g_utf8_next_char (ch), i++)
+    out->chars[i] = g_utf8_get_char (ch);
+}
+
+static inline gunichar
+istring_char_at (IndexedStringData *istring,
+                 glong              i)
+{
+  return istring->chars != NULL
+             ? istring->chars[i]
+             : (gunichar) (guchar) istring->ptr[i];
+}
+
+/* Code points are folded to 10 bits each, so grams
+ * outside of the lower planes may collide. This only
+ * yields extra candidates, which the scorer will sort out
+ */
+static inline guint
+make_gram (IndexedStringData *istring,
+           glong              i)
+{
+  return ((istring_char_at (istring, i) & 0x3ff) << 20) |
+         ((istring_char_at (istring, i + 1) & 0x3ff) << 10) |
+         (istring_char_at (istring, i + 2) & 0x3ff);
+}
+
+/* Returns a mask with bit `n` set wherever `against`
+ * has `ch` at position `n`. `padded` must hold the
+ * bytes of `against` zero-padded to 64 if it is ASCII
+ */
+static inline guint64
+match_bits (IndexedStringData *against,
+            const guint8      *padded,
+            gunichar           ch)
+{
+  guint64 mask = 0;
+
+  if (against->chars != NULL)
     {
-      out->chars[i].ch   = g_utf8_get_char (ch);
-      out->chars[i].type = g_unichar_type (out->chars[i].ch);
+      for (glong j = 0; j < against->utf8_len; j++)
+        mask |= (guint64) (against->chars[j] == ch) << j;
+      return mask;
     }
+
+  if (ch >= 0x80)
+    return 0;
+
+#ifdef __SSE2__
+  {
+    __m128i needle = _mm_set1_epi8 ((char) ch);
+
+    for (glong j = 0; j * 16 < against->utf8_len; j++)
+      {
+        __m128i block = _mm_loadu_si128 ((const __m128i *) (padded + j * 16));
+        guint   bits  = _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, needle));
+
+        mask |= (guint64) bits << (j * 16);
+      }
+  }
+#else
+  for (glong j = 0; j < against->utf8_len; j++)
+    mask |= (guint64) (padded[j] == ch) << j;
+#endif
+
+  return mask;
 }
 
-static inline double
-test_chars (IndexedChar *a,
-            IndexedChar *b)
-{
-  if (a->ch == b->ch)
-    return PERFECT;
-
-  // if ((a->type == G_UNICODE_LOWERCASE_LETTER ||
-  //      a->type == G_UNICODE_MODIFIER_LETTER ||
-  //      a->type == G_UNICODE_OTHER_LETTER ||
-  //      a->type == G_UNICODE_TITLECASE_LETTER ||
-  //      a->type == G_UNICODE_LOWERCASE_LETTER) &&
-
-  //     (b->type == G_UNICODE_LOWERCASE_LETTER ||
-  //      b->type == G_UNICODE_MODIFIER_LETTER ||
-  //      b->type == G_UNICODE_OTHER_LETTER ||
-  //      b->type == G_UNICODE_TITLECASE_LETTER ||
-  //      b->type == G_UNICODE_LOWERCASE_LETTER))
-  //   return SAME_CLUSTER;
-
-  // if ((a->type == G_UNICODE_DECIMAL_NUMBER ||
-  //      a->type == G_UNICODE_LETTER_NUMBER ||
-  //      a->type == G_UNICODE_OTHER_NUMBER) &&
-
-  //     (b->type == G_UNICODE_DECIMAL_NUMBER ||
-  //      b->type == G_UNICODE_LETTER_NUMBER ||
-  //      b->type == G_UNICODE_OTHER_NUMBER))
-  //   return SAME_CLUSTER;
-
-  // if ((a->type == G_UNICODE_CONNECT_PUNCTUATION ||
-  //      a->type == G_UNICODE_DASH_PUNCTUATION ||
-  //      a->type == G_UNICODE_CLOSE_PUNCTUATION ||
-  //      a->type == G_UNICODE_FINAL_PUNCTUATION ||
-  //      a->type == G_UNICODE_INITIAL_PUNCTUATION ||
-  //      a->type == G_UNICODE_OTHER_PUNCTUATION ||
-  //      a->type == G_UNICODE_OPEN_PUNCTUATION) &&
-
-  //     (b->type == G_UNICODE_CONNECT_PUNCTUATION ||
-  //      b->type == G_UNICODE_DASH_PUNCTUATION ||
-  //      b->type == G_UNICODE_CLOSE_PUNCTUATION ||
-  //      b->type == G_UNICODE_FINAL_PUNCTUATION ||
-  //      b->type == G_UNICODE_INITIAL_PUNCTUATION ||
-  //      b->type == G_UNICODE_OTHER_PUNCTUATION ||
-  //      b->type == G_UNICODE_OPEN_PUNCTUATION))
-  //   return SAME_CLUSTER;
-
-  return NO_MATCH;
+/* The first match after the previous one wins; if
+ * there is none, the last match in the string does.
+ * For the very first query character, the first match
+ * in the string is taken
+ */
+static inline guint
+find_best_idx_bits (guint64 mask,
+                    guint   last_best_idx)
+{
+  guint64 after = 0;
+
+  if (mask == 0)
+    return G_MAXUINT;
+  if (last_best_idx == G_MAXUINT)
+    return __builtin_ctzll (mask);
+
+  if (last_best_idx < 63)
+    after = mask & (G_MAXUINT64 << (last_best_idx + 1));
+  if (after != 0)
+    return __builtin_ctzll (after);
+
+  return 63 - __builtin_clzll (mask);
+}
+
+static inline guint
+find_best_idx_scalar (IndexedStringData *against,
+                      gunichar           ch,
+                      guint              last_best_idx)
+{
+  guint first = G_MAXUINT;
+  guint after = G_MAXUINT;
+  guint last  = G_MAXUINT;
+
+  for (glong j = 1; j < against->utf8_len; j++)
+    {
+      if (istring_char_at (against, j) != ch)
+        continue;
+
+      if (first == G_MAXUINT)
+        first = j;
+      if (after == G_MAXUINT && (guint) j > last_best_idx)
+        after = j;
+      last = j;
+    }
+
+  if (first == G_MAXUINT)
+    return G_MAXUINT;
+  if (last_best_idx == G_MAXUINT)
+    return first;
+
+  return after != G_MAXUINT ? after : last;
 }
 
 static inline double
 test_strings (IndexedStringData *query,
               IndexedStringData *against)
 {
-  guint  last_best_idx = G_MAXUINT;
-  guint  misses        = 0;
-  double score         = 0.0;
+  gboolean bit_parallel                 = FALSE;
+  guint8   padded[MAX_BIT_PARALLEL_LEN] = { 0 };
+  guint64  valid                        = 0;
+  guint    last_best_idx                = G_MAXUINT;
+  guint    misses                       = 0;
+  double   score                        = 0.0;
+
+  bit_parallel = against->utf8_len <= MAX_BIT_PARALLEL_LEN;
+  if (bit_parallel)
+    {
+      if (against->chars == NULL)
+        memcpy (padded, against->ptr, against->utf8_len);
+
+      valid = against->utf8_len < MAX_BIT_PARALLEL_LEN
+                  ? (G_GUINT64_CONSTANT (1) << against->utf8_len) - 1
+                  : G_MAXUINT64;
+      /* The first character of a string is never matched against */
+      valid &= ~G_GUINT64_CONSTANT (1);
+    }
 
-  for (guint i = 0; i < query->utf8_len; i++)
+  for (glong i = 0; i < query->utf8_len; i++)
     {
-      guint  best_idx   = G_MAXUINT;
-      double best_score = 0.0;
+      gunichar ch         = 0;
+      guint    best_idx   = G_MAXUINT;
+      double   best_score = PERFECT;
+
+      ch = istring_char_at (query, i);
+      if (bit_parallel)
+        best_idx = find_best_idx_bits (
+            match_bits (against, padded, ch) & valid,
+            last_best_idx);
+      else
+        best_idx = find_best_idx_scalar (against, ch, last_best_idx);
 
-      for (guint j = against->utf8_len; j > 1; j--)
+      if (best_idx == G_MAXUINT)
         {
-          double tmp_score = 0;
-
-          tmp_score = test_chars (&query->chars[i], &against->chars[j - 1]);
-          if (tmp_score > NO_MATCH &&
-              (tmp_score > best_score ||
-               ((last_best_idx == G_MAXUINT ||
-                 j - 1 > last_best_idx) &&
-                tmp_score >= best_score)))
-            {
-              best_idx   = j - 1;
-              best_score = tmp_score;
-            }
+          misses++;
+          continue;
         }
 
-      if (best_idx != G_MAXUINT)
+      if (last_best_idx != G_MAXUINT)
         {
-          if (last_best_idx != G_MAXUINT)
-            {
-              int diff = 0;
-
-              diff = (int) best_idx - (int) last_best_idx;
-              if (diff > 1)
-                /* Penalize the query for fragmentation */
-                best_score /= (double) diff / 2.0;
-              else if (diff < 0)
-                /* Penalize the query more harshly for
-                 * transposing and fragmentation
-                 */
-                best_score /= (double) ABS (diff);
-            }
-
-          score += best_score;
-          last_best_idx = best_idx;
+          int diff = 0;
+
+          diff = (int) best_idx - (int) last_best_idx;
+          if (diff > 1)
+            /* Penalize the query for fragmentation */
+            best_score /= (double) diff / 2.0;
+          else if (diff < 0)
+            /* Penalize the query more harshly for
+             * transposing and fragmentation
+             */
+            best_score /= (double) ABS (diff);
         }
-      else
-        misses++;
+
+      score += best_score;
+      last_best_idx = best_idx;
     }
 
   /* Penalize the query for including chars that didn't match at all */
@@ -649,11 +2109,628 @@ test_strings (IndexedStringData *query,
   return score;
 }
 
+static void
+group_record_clear (GroupRecord *record)
+{
+  g_clear_object (&record->group);
+  g_clear_object (&record->default_result);
+  g_clear_pointer (&record->arena, string_arena_data_unref);
+}
+
+static GArray *
+group_records_new (guint reserved)
+{
+  GArray *records = NULL;
+
+  records = g_array_sized_new (FALSE, TRUE, sizeof (GroupRecord), reserved);
+  g_array_set_clear_func (records, (GDestroyNotify) group_record_clear);
+
+  return records;
+}
+
+/* Appends new references to the `n` records of
+ * `src` starting at `position` onto `dest`
+ */
+static void
+append_group_records (GArray *dest,
+                      GArray *src,
+                      guint   position,
+                      guint   n)
+{
+  guint first = dest->len;
+
+  if (n == 0)
+    return;
+
+  g_array_set_size (dest, first + n);
+  for (guint i = 0; i < n; i++)
+    {
+      GroupRecord *from = NULL;
+      GroupRecord *to   = NULL;
+
+      from = &g_array_index (src, GroupRecord, position + i);
+      to   = &g_array_index (dest, GroupRecord, first + i);
+
+      to->group          = g_object_ref (from->group);
+      to->default_result = g_object_ref (from->default_result);
+      to->arena          = string_arena_data_ref (from->arena);
+      to->first_istring  = from->first_istring;
+      to->n_istrings     = from->n_istrings;
+      to->flags          = from->flags;
+    }
+}
+
+static void
+arena_add_string (GByteArray *strings,
+                  GArray     *chars,
+                  GArray     *istrings,
+                  const char *s,
+                  double      weight)
+{
+  g_autofree char  *casefolded = NULL;
+  gsize             length     = 0;
+  IndexedStringData append     = { 0 };
+
+  casefolded = normalize_string (s);
+  length     = strlen (casefolded);
+
+  append.utf8_len = g_utf8_strlen (casefolded, length);
+  append.weight   = weight;
+  g_array_append_val (istrings, append);
+
+  g_byte_array_append (strings, (const guint8 *) casefolded, length + 1);
+  if ((glong) length == append.utf8_len)
+    return;
+
+  for (const char *ch = casefolded; *ch != '\0'; ch = g_utf8_next_char (ch))
+    {
+      gunichar uc = 0;
+
+      uc = g_utf8_get_char (ch);
+      g_array_append_val (chars, uc);
+    }
+}
+
+static StringArenaData *
+string_arena_new_take (GByteArray *strings,
+                       GArray     *chars,
+                       GArray     *istrings)
+{
+  g_autoptr (StringArenaData) arena = NULL;
+
+  arena             = string_arena_data_new ();
+  arena->n_istrings = istrings->len;
+  arena->strings    = (char *) g_byte_array_free (strings, FALSE);
+  arena->chars      = (gunichar *) (gpointer) g_array_free (chars, FALSE);
+  arena->istrings   = (IndexedStringData *) (gpointer) g_array_free (istrings, FALSE);
+
+  /* The buffers will not move anymore, so
+   * the records can now point into them
+   */
+  string_arena_relocate (arena, arena->strings);
+
+  return g_steal_pointer (&arena);
+}
+
+/* Points the records of `arena` at consecutive NUL-terminated
+ * strings starting at `strings` and at their code points
+ */
+static void
+string_arena_relocate (StringArenaData *arena,
+                       char            *strings)
+{
+  char     *string_ptr = strings;
+  gunichar *chars_ptr  = arena->chars;
+
+  for (guint i = 0; i < arena->n_istrings; i++)
+    {
+      IndexedStringData *istring = NULL;
+      gsize              length  = 0;
+
+      istring      = &arena->istrings[i];
+      istring->ptr = string_ptr;
+      length       = strlen (string_ptr);
+      string_ptr += length + 1;
+
+      if ((glong) length != istring->utf8_len)
+        {
+          istring->chars = chars_ptr;
+          chars_ptr += istring->utf8_len;
+        }
+    }
+}
+
+static IndexSnapshotData *
+index_snapshot_new_take (GArray *groups)
+{
+  g_autoptr (IndexSnapshotData) snapshot = NULL;
+
+  snapshot         = index_snapshot_data_new ();
+  snapshot->groups = groups;
+
+  /* Indices have shifted, so rebuild the postings from the
+   * already normalized strings instead of patching them
+   */
+  if (groups->len > 0)
+    {
+      snapshot->grams = build_gram_index (groups);
+      snapshot->typos = build_typo_index (groups);
+    }
+
+  return g_steal_pointer (&snapshot);
+}
+
+static inline IndexSnapshotData *
+get_active_snapshot (BzSearchEngine *self)
+{
+  /* Until the live index has any groups, the
+   * one persisted from a previous session is used
+   */
+  if (self->snapshot->groups->len == 0 && self->persisted != NULL)
+    return self->persisted;
+  return self->snapshot;
+}
+
+static char *
+dup_index_path (void)
+{
+  g_autofree char *module_dir = NULL;
+
+  module_dir = bz_dup_module_dir ();
+  return g_build_filename (module_dir, PERSISTED_INDEX_FILENAME, NULL);
+}
+
+static GVariant *
+map_index_file (const char *path,
+                GError    **error)
+{
+  g_autoptr (GMappedFile) mapped = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GVariant) variant   = NULL;
+  guint32 version                = 0;
+
+  mapped = g_mapped_file_new (path, FALSE, error);
+  if (mapped == NULL)
+    return NULL;
+
+  bytes   = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (
+      G_VARIANT_TYPE (PERSISTED_INDEX_TYPE), bytes, FALSE));
+
+  g_variant_get_child (variant, 0, "u", &version);
+  if (version != PERSISTED_INDEX_VERSION)
+    {
+      g_set_error (
+          error,
+          G_IO_ERROR,
+          G_IO_ERROR_INVALID_DATA,
+          "Persisted search index at '%s' has version %u, expected %u",
+          path, version, PERSISTED_INDEX_VERSION);
+      return NULL;
+    }
+
+  return g_steal_pointer (&variant);
+}
+
+static DexFuture *
+load_task_fiber (LoadTaskData *data)
+{
+  char *path                         = data->path;
+  g_autoptr (GError) local_error     = NULL;
+  g_autoptr (GVariant) variant       = NULL;
+  g_autoptr (GVariant) strings_value = NULL;
+  g_autoptr (GVariant) weights_value = NULL;
+  g_autoptr (GVariant) counts_value  = NULL;
+  g_autoptr (GVariant) metas         = NULL;
+  const char    *strings             = NULL;
+  gsize          strings_len         = 0;
+  const double  *weights             = NULL;
+  gsize          n_weights           = 0;
+  const guint32 *counts              = NULL;
+  gsize          n_counts            = 0;
+  guint64        n_counted           = 0;
+  const char    *string_ptr          = NULL;
+  g_autoptr (GArray) chars           = NULL;
+  g_autoptr (GArray) istrings        = NULL;
+  g_autoptr (StringArenaData) arena  = NULL;
+  g_autoptr (GArray) groups          = NULL;
+  guint offset                       = 0;
+
+  variant = map_index_file (path, &local_error);
+  if (variant == NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  strings_value = g_variant_get_child_value (variant, 2);
+  weights_value = g_variant_get_child_value (variant, 3);
+  counts_value  = g_variant_get_child_value (variant, 4);
+  metas         = g_variant_get_child_value (variant, 5);
+
+  strings = g_variant_get_fixed_array (strings_value, &strings_len, sizeof (char));
+  weights = g_variant_get_fixed_array (weights_value, &n_weights, sizeof (double));
+  counts  = g_variant_get_fixed_array (counts_value, &n_counts, sizeof (guint32));
+
+  if (n_counts != g_variant_n_children (metas) ||
+      (strings_len > 0 && strings[strings_len - 1] != '\0'))
+    goto invalid;
+  for (gsize i = 0; i < n_counts; i++)
+    n_counted += counts[i];
+  if (n_counted != n_weights)
+    goto invalid;
+
+  chars    = g_array_new (FALSE, FALSE, sizeof (gunichar));
+  istrings = g_array_sized_new (FALSE, TRUE, sizeof (IndexedStringData), n_weights);
+
+  /* The strings are used straight from the mapping,
+   * only the code points of non-ASCII ones are decoded
+   */
+  string_ptr = strings;
+  for (gsize i = 0; i < n_weights; i++)
+    {
+      IndexedStringData append = { 0 };
+      gsize             length = 0;
+
+      if (string_ptr >= strings + strings_len)
+        goto invalid;
+
+      length = strlen (string_ptr);
+      if (!g_utf8_validate (string_ptr, length, NULL))
+        goto invalid;
+
+      append.utf8_len = g_utf8_strlen (string_ptr, length);
+      append.weight   = weights[i];
+      g_array_append_val (istrings, append);
+
+      if ((glong) length != append.utf8_len)
+        {
+          for (const char *ch = string_ptr; *ch != '\0'; ch = g_utf8_next_char (ch))
+            {
+              gunichar uc = 0;
+
+              uc = g_utf8_get_char (ch);
+              g_array_append_val (chars, uc);
+            }
+        }
+
+      string_ptr += length + 1;
+    }
+
+  arena             = string_arena_data_new ();
+  arena->backing    = g_variant_ref (variant);
+  arena->n_istrings = istrings->len;
+  arena->chars      = (gunichar *) (gpointer) g_array_free (g_steal_pointer (&chars), FALSE);
+  arena->istrings   = (IndexedStringData *) (gpointer) g_array_free (g_steal_pointer (&istrings), FALSE);
+  string_arena_relocate (arena, (char *) strings);
+
+  groups = group_records_new (n_counts);
+  g_array_set_size (groups, n_counts);
+  for (gsize i = 0; i < n_counts; i++)
+    {
+      GroupRecord *record = NULL;
+
+      record                = &g_array_index (groups, GroupRecord, i);
+      record->arena         = string_arena_data_ref (arena);
+      record->first_istring = offset;
+      record->n_istrings    = counts[i];
+      offset += counts[i];
+
+      g_variant_get_child (metas, i, "(&s&s&su)", NULL, NULL, NULL, &record->flags);
+    }
+
+  data->snapshot        = index_snapshot_new_take (g_steal_pointer (&groups));
+  data->snapshot->metas = g_steal_pointer (&metas);
+  return dex_future_new_true ();
+
+invalid:
+  return dex_future_new_reject (
+      G_IO_ERROR,
+      G_IO_ERROR_INVALID_DATA,
+      "Persisted search index at '%s' is malformed",
+      path);
+}
+
+static DexFuture *
+load_index_then (DexFuture    *future,
+                 LoadTaskData *data)
+{
+  g_autoptr (BzSearchEngine) self = NULL;
+
+  bz_weak_get_or_return_reject (self, &data->engine_wr);
+
+  /* The live index got here first */
+  if (self->records->len > 0)
+    return dex_future_new_false ();
+
+  g_clear_pointer (&self->persisted, index_snapshot_data_unref);
+  self->persisted = index_snapshot_data_ref (data->snapshot);
+  invalidate_query_cache (self->cache);
+
+  g_debug ("Loaded persisted search index with %u groups", self->persisted->groups->len);
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+save_task_fiber (SaveTaskData *data)
+{
+  GArray *groups                  = data->snapshot->groups;
+  char   *path                    = data->path;
+  g_autoptr (GError) local_error  = NULL;
+  g_autoptr (GByteArray) strings  = NULL;
+  g_autoptr (GArray) weights      = NULL;
+  g_autoptr (GArray) counts       = NULL;
+  guint64 generation              = 0;
+  g_autoptr (GVariant) existing   = NULL;
+  g_autoptr (GVariant) variant    = NULL;
+  g_autofree char *parent         = NULL;
+  gboolean         result         = FALSE;
+
+  strings = g_byte_array_new ();
+  weights = g_array_new (FALSE, FALSE, sizeof (double));
+  counts  = g_array_sized_new (FALSE, FALSE, sizeof (guint32), groups->len);
+
+  for (guint i = 0; i < groups->len; i++)
+    {
+      GroupRecord       *record   = NULL;
+      IndexedStringData *istrings = NULL;
+      guint32            count    = 0;
+
+      record   = &g_array_index (groups, GroupRecord, i);
+      istrings = record->arena->istrings + record->first_istring;
+      count    = record->n_istrings;
+      g_array_append_val (counts, count);
+
+      for (guint j = 0; j < record->n_istrings; j++)
+        {
+          g_byte_array_append (
+              strings,
+              (const guint8 *) istrings[j].ptr,
+              strlen (istrings[j].ptr) + 1);
+          g_array_append_val (weights, istrings[j].weight);
+        }
+    }
+
+  /* The generation identifies the catalog the index was
+   * built from, so an unchanged one is not rewritten
+   */
+  generation = hash_bytes (FNV_OFFSET_BASIS, strings->data, strings->len);
+  generation = hash_bytes (generation, weights->data, weights->len * sizeof (double));
+  generation = hash_bytes (generation, counts->data, counts->len * sizeof (guint32));
+  generation = hash_bytes (generation, g_variant_get_data (data->metas), g_variant_get_size (data->metas));
+
+  existing = map_index_file (path, NULL);
+  if (existing != NULL)
+    {
+      guint64 existing_generation = 0;
+
+      g_variant_get_child (existing, 1, "t", &existing_generation);
+      if (existing_generation == generation)
+        return dex_future_new_true ();
+    }
+
+  variant = g_variant_ref_sink (g_variant_new (
+      "(ut@ay@ad@au@a(sssu))",
+      PERSISTED_INDEX_VERSION,
+      generation,
+      g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, strings->data, strings->len, sizeof (guint8)),
+      g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE, weights->data, weights->len, sizeof (double)),
+      g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32, counts->data, counts->len, sizeof (guint32)),
+      data->metas));
+
+  parent = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (parent, 0755) != 0)
+    return dex_future_new_reject (
+        G_IO_ERROR,
+        g_io_error_from_errno (errno),
+        "Failed to make parent directory '%s' for the search index: %s",
+        parent, g_strerror (errno));
+
+  result = g_file_set_contents (
+      path,
+      g_variant_get_data (variant),
+      g_variant_get_size (variant),
+      &local_error);
+  if (!result)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  g_debug ("Persisted search index with %u groups to %s", groups->len, path);
+  return dex_future_new_true ();
+}
+
+static guint64
+hash_bytes (guint64       hash,
+            gconstpointer data,
+            gsize         size)
+{
+  const guint8 *bytes = data;
+
+  for (gsize i = 0; i < size; i++)
+    {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+    }
+
+  return hash;
+}
+
 static gint
 cmp_scores (Score *a,
             Score *b)
 {
-  return (b->val - a->val < 0.0) ? -1 : 1;
+  /* Sub-tasks finish in no particular order, so
+   * break ties by index to keep results stable
+   */
+  if (a->val != b->val)
+    return (b->val - a->val < 0.0) ? -1 : 1;
+  return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+/* Keeps the `limit` best scores seen so far in a
+ * min-heap, so the worst of them is always at the root
+ */
+static void
+score_heap_push (GArray *heap,
+                 guint   limit,
+                 Score  *score)
+{
+  Score *scores = NULL;
+  guint  i      = 0;
+
+  if (heap->len < limit)
+    {
+      g_array_append_val (heap, *score);
+      scores = (Score *) heap->data;
+
+      for (i = heap->len - 1; i > 0;)
+        {
+          guint parent = 0;
+          Score tmp    = { 0 };
+
+          parent = (i - 1) / 2;
+          if (scores[parent].val <= scores[i].val)
+            break;
+
+          tmp            = scores[parent];
+          scores[parent] = scores[i];
+          scores[i]      = tmp;
+          i              = parent;
+        }
+      return;
+    }
+
+  scores = (Score *) heap->data;
+  if (score->val <= scores[0].val)
+    return;
+
+  scores[0] = *score;
+  for (;;)
+    {
+      guint left     = 0;
+      guint right    = 0;
+      guint smallest = 0;
+      Score tmp      = { 0 };
+
+      left     = 2 * i + 1;
+      right    = left + 1;
+      smallest = i;
+
+      if (left < heap->len && scores[left].val < scores[smallest].val)
+        smallest = left;
+      if (right < heap->len && scores[right].val < scores[smallest].val)
+        smallest = right;
+      if (smallest == i)
+        break;
+
+      tmp              = scores[smallest];
+      scores[smallest] = scores[i];
+      scores[i]        = tmp;
+      i                = smallest;
+    }
+}
+
+static gint
+cmp_indices (guint *a,
+             guint *b)
+{
+  return (*a > *b) - (*a < *b);
+}
+
+static void
+invalidate_query_cache (QueryCacheData *cache)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&cache->mutex);
+  cache->generation++;
+  if (cache->entries->len > 0)
+    g_ptr_array_remove_range (cache->entries, 0, cache->entries->len);
+}
+
+static GArray *
+query_cache_lookup (QueryCacheData *cache,
+                    guint           generation,
+                    const char     *query,
+                    guint           filter,
+                    gboolean       *exact)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  guint            best_idx       = G_MAXUINT;
+  gsize            best_len       = 0;
+  CachedQueryData *best           = NULL;
+
+  *exact = FALSE;
+
+  locker = g_mutex_locker_new (&cache->mutex);
+  if (generation != cache->generation)
+    return NULL;
+
+  for (guint i = 0; i < cache->entries->len; i++)
+    {
+      CachedQueryData *entry = NULL;
+      gsize            len   = 0;
+
+      entry = g_ptr_array_index (cache->entries, i);
+      /* Scores filtered by fewer flags are a superset
+       * of the ones we are after, so they still narrow
+       * down the candidates
+       */
+      if ((entry->filter & filter) != entry->filter ||
+          !g_str_has_prefix (query, entry->query))
+        continue;
+
+      len = strlen (entry->query);
+      if (best_idx == G_MAXUINT || len > best_len ||
+          (len == best_len && entry->filter == filter))
+        {
+          best_idx = i;
+          best_len = len;
+        }
+    }
+  if (best_idx == G_MAXUINT)
+    return NULL;
+
+  /* Move to the back so the least recently
+   * used queries are evicted first
+   */
+  best = g_ptr_array_steal_index (cache->entries, best_idx);
+  g_ptr_array_add (cache->entries, best);
+
+  *exact = query[best_len] == '\0' && best->filter == filter;
+  return g_array_ref (best->scores);
+}
+
+static void
+query_cache_store (QueryCacheData *cache,
+                   guint           generation,
+                   const char     *query,
+                   guint           filter,
+                   GArray         *scores)
+{
+  g_autoptr (GMutexLocker) locker   = NULL;
+  g_autoptr (CachedQueryData) entry = NULL;
+
+  locker = g_mutex_locker_new (&cache->mutex);
+  if (generation != cache->generation)
+    return;
+
+  for (guint i = 0; i < cache->entries->len; i++)
+    {
+      CachedQueryData *existing = NULL;
+
+      existing = g_ptr_array_index (cache->entries, i);
+      if (existing->filter == filter &&
+          g_strcmp0 (existing->query, query) == 0)
+        {
+          g_ptr_array_remove_index (cache->entries, i);
+          break;
+        }
+    }
+  if (cache->entries->len >= MAX_CACHED_QUERIES)
+    g_ptr_array_remove_index (cache->entries, 0);
+
+  entry         = cached_query_data_new ();
+  entry->query  = g_strdup (query);
+  entry->filter = filter;
+  entry->scores = g_array_ref (scores);
+  g_ptr_array_add (cache->entries, g_steal_pointer (&entry));
 }
 
 /* End of bz-search-engine.c */
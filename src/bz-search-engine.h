@@ -23,8 +23,17 @@
 #include <gtk/gtk.h>
 #include <libdex.h>
 
+#include "bz-search-result-model.h"
+
 G_BEGIN_DECLS
 
+typedef enum
+{
+  BZ_SEARCH_FILTER_NONE    = 0,
+  BZ_SEARCH_FILTER_FOSS    = 1 << 0,
+  BZ_SEARCH_FILTER_FLATHUB = 1 << 1,
+} BzSearchFilterFlags;
+
 #define BZ_TYPE_SEARCH_ENGINE (bz_search_engine_get_type ())
 G_DECLARE_FINAL_TYPE (BzSearchEngine, bz_search_engine, BZ, SEARCH_ENGINE, GObject)
 
@@ -42,6 +51,29 @@ DexFuture *
 bz_search_engine_query (BzSearchEngine    *self,
                         const char *const *terms);
 
+DexFuture *
+bz_search_engine_query_limited (BzSearchEngine     *self,
+                                const char *const  *terms,
+                                BzSearchFilterFlags filter,
+                                guint               limit,
+                                GCancellable       *cancellable);
+
+DexFuture *
+bz_search_engine_query_into (BzSearchEngine      *self,
+                             const char *const   *terms,
+                             BzSearchFilterFlags  filter,
+                             GCancellable        *cancellable,
+                             BzSearchResultModel *model);
+
+DexFuture *
+bz_search_engine_wait_for_index (BzSearchEngine *self);
+
+DexFuture *
+bz_search_engine_load_index (BzSearchEngine *self);
+
+DexFuture *
+bz_search_engine_save_index (BzSearchEngine *self);
+
 G_END_DECLS
 
 /* End of bz-search-engine.h */
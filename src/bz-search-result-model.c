@@ -0,0 +1,478 @@
+/* bz-search-result-model.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bz-search-result-model.h"
+
+/* Results nobody else holds on to are kept around for
+ * the next set of scores, up to about a screenful
+ */
+#define MAX_POOLED_RESULTS 256
+
+/* Past this many separate changes, everything between
+ * the first and the last one is replaced at once
+ */
+#define MAX_CHANGED_RANGES 32
+
+struct _BzSearchResultModel
+{
+  GObject parent_instance;
+
+  /* BzSearchScore */
+  GArray *scores;
+  /* BzSearchResult or NULL until first requested,
+   * each held through a toggle reference
+   */
+  GPtrArray  *items;
+  GPtrArray  *pool;
+  /* Items nobody but us holds on to right now */
+  GHashTable *idle;
+
+  BzSearchResultFillFunc fill_func;
+  gpointer               user_data;
+  GDestroyNotify         destroy_user_data;
+};
+
+static void list_model_iface_init (GListModelInterface *iface);
+G_DEFINE_FINAL_TYPE_WITH_CODE (
+    BzSearchResultModel,
+    bz_search_result_model,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init));
+
+typedef struct
+{
+  guint old_pos;
+  guint new_pos;
+} Anchor;
+
+static void
+update_scores (BzSearchResultModel *self,
+               GArray              *scores);
+
+static GArray *
+collect_anchors (GArray *old_scores,
+                 GArray *new_scores);
+
+static void
+release_items (BzSearchResultModel *self,
+               GPtrArray           *items);
+
+static void
+toggle_notify (gpointer data,
+               GObject *object,
+               gboolean is_last_ref);
+
+static void
+bz_search_result_model_dispose (GObject *object)
+{
+  BzSearchResultModel *self = BZ_SEARCH_RESULT_MODEL (object);
+
+  if (self->items != NULL)
+    release_items (self, self->items);
+  g_clear_pointer (&self->items, g_ptr_array_unref);
+  g_clear_pointer (&self->pool, g_ptr_array_unref);
+  g_clear_pointer (&self->idle, g_hash_table_unref);
+  g_clear_pointer (&self->scores, g_array_unref);
+
+  if (self->destroy_user_data != NULL)
+    g_clear_pointer (&self->user_data, self->destroy_user_data);
+  self->destroy_user_data = NULL;
+
+  G_OBJECT_CLASS (bz_search_result_model_parent_class)->dispose (object);
+}
+
+static void
+bz_search_result_model_class_init (BzSearchResultModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = bz_search_result_model_dispose;
+}
+
+static GType
+list_model_get_item_type (GListModel *list)
+{
+  return BZ_TYPE_SEARCH_RESULT;
+}
+
+static guint
+list_model_get_n_items (GListModel *list)
+{
+  BzSearchResultModel *self = BZ_SEARCH_RESULT_MODEL (list);
+
+  return self->scores != NULL ? self->scores->len : 0;
+}
+
+static gpointer
+list_model_get_item (GListModel *list,
+                     guint       position)
+{
+  BzSearchResultModel *self   = BZ_SEARCH_RESULT_MODEL (list);
+  BzSearchResult      *result = NULL;
+
+  if (self->scores == NULL || position >= self->scores->len)
+    return NULL;
+
+  result = g_ptr_array_index (self->items, position);
+  if (result == NULL)
+    {
+      if (self->pool->len > 0)
+        result = g_ptr_array_steal_index_fast (self->pool, self->pool->len - 1);
+      else
+        result = bz_search_result_new ();
+
+      self->fill_func (
+          result,
+          &g_array_index (self->scores, BzSearchScore, position),
+          self->user_data);
+      g_ptr_array_index (self->items, position) = result;
+
+      /* The reference we already own goes to the caller */
+      g_object_add_toggle_ref (G_OBJECT (result), toggle_notify, self);
+      return result;
+    }
+
+  return g_object_ref (result);
+}
+
+static void
+list_model_iface_init (GListModelInterface *iface)
+{
+  iface->get_item_type = list_model_get_item_type;
+  iface->get_n_items   = list_model_get_n_items;
+  iface->get_item      = list_model_get_item;
+}
+
+static void
+bz_search_result_model_init (BzSearchResultModel *self)
+{
+  self->items = g_ptr_array_new ();
+  self->pool  = g_ptr_array_new_with_free_func (g_object_unref);
+  self->idle  = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+BzSearchResultModel *
+bz_search_result_model_new (void)
+{
+  return g_object_new (BZ_TYPE_SEARCH_RESULT_MODEL, NULL);
+}
+
+/* Replaces the contents of the model with `scores`. Items are
+ * only created once requested, by calling `fill_func` on a
+ * pooled or new result, which must set every property. When
+ * the new scores index into the same `user_data`, results
+ * present in both keep their objects and only what actually
+ * moved is reported as changed
+ */
+void
+bz_search_result_model_set_scores (BzSearchResultModel   *self,
+                                   GArray                *scores,
+                                   BzSearchResultFillFunc fill_func,
+                                   gpointer               user_data,
+                                   GDestroyNotify         destroy_user_data)
+{
+  guint          had_n_items           = 0;
+  guint          have_n_items          = 0;
+  g_autoptr (GPtrArray) old_items      = NULL;
+  gpointer       old_user_data         = NULL;
+  GDestroyNotify old_destroy_user_data = NULL;
+
+  g_return_if_fail (BZ_IS_SEARCH_RESULT_MODEL (self));
+  g_return_if_fail (scores == NULL || fill_func != NULL);
+
+  if (scores != NULL &&
+      self->scores != NULL &&
+      fill_func == self->fill_func &&
+      user_data == self->user_data)
+    {
+      update_scores (self, scores);
+      /* We already hold on to `user_data` */
+      if (destroy_user_data != NULL)
+        destroy_user_data (user_data);
+      return;
+    }
+
+  had_n_items           = self->scores != NULL ? self->scores->len : 0;
+  old_items             = g_steal_pointer (&self->items);
+  old_user_data         = self->user_data;
+  old_destroy_user_data = self->destroy_user_data;
+  g_clear_pointer (&self->scores, g_array_unref);
+
+  self->fill_func         = fill_func;
+  self->user_data         = user_data;
+  self->destroy_user_data = destroy_user_data;
+
+  if (scores != NULL)
+    {
+      self->scores = g_array_ref (scores);
+      have_n_items = scores->len;
+    }
+  self->items = g_ptr_array_sized_new (have_n_items);
+  g_ptr_array_set_size (self->items, have_n_items);
+
+  g_list_model_items_changed (G_LIST_MODEL (self), 0, had_n_items, have_n_items);
+
+  /* Only now have list items let go of the old results */
+  release_items (self, old_items);
+  if (old_destroy_user_data != NULL)
+    old_destroy_user_data (old_user_data);
+}
+
+static void
+update_scores (BzSearchResultModel *self,
+               GArray              *scores)
+{
+  guint old_len              = 0;
+  g_autoptr (GArray) anchors = NULL;
+  guint n_ranges             = 0;
+  guint old_pos              = 0;
+  guint new_pos              = 0;
+  GArray *working            = NULL;
+
+  old_len = self->scores->len;
+  anchors = collect_anchors (self->scores, scores);
+
+  for (guint i = 0; i <= anchors->len; i++)
+    {
+      Anchor next = { old_len, scores->len };
+
+      if (i < anchors->len)
+        next = g_array_index (anchors, Anchor, i);
+      if (next.old_pos > old_pos || next.new_pos > new_pos)
+        n_ranges++;
+
+      old_pos = next.old_pos + 1;
+      new_pos = next.new_pos + 1;
+    }
+
+  if (n_ranges > MAX_CHANGED_RANGES)
+    {
+      guint n_prefix = 0;
+      guint n_suffix = 0;
+
+      /* Keep the unchanged ends only */
+      while (n_prefix < anchors->len &&
+             g_array_index (anchors, Anchor, n_prefix).old_pos == n_prefix &&
+             g_array_index (anchors, Anchor, n_prefix).new_pos == n_prefix)
+        n_prefix++;
+      while (n_suffix < anchors->len - n_prefix &&
+             g_array_index (anchors, Anchor, anchors->len - 1 - n_suffix).old_pos == old_len - 1 - n_suffix &&
+             g_array_index (anchors, Anchor, anchors->len - 1 - n_suffix).new_pos == scores->len - 1 - n_suffix)
+        n_suffix++;
+      g_array_remove_range (anchors, n_prefix, anchors->len - n_prefix - n_suffix);
+    }
+
+  /* The shared scores are never modified, so the
+   * intermediate states are built up in a copy
+   */
+  working = g_array_sized_new (FALSE, FALSE, sizeof (BzSearchScore), MAX (old_len, scores->len));
+  g_array_append_vals (working, self->scores->data, old_len);
+  g_array_unref (self->scores);
+  self->scores = working;
+
+  old_pos = 0;
+  new_pos = 0;
+  for (guint i = 0; i <= anchors->len; i++)
+    {
+      Anchor next      = { old_len, scores->len };
+      guint  n_removed = 0;
+      guint  n_added   = 0;
+
+      if (i < anchors->len)
+        next = g_array_index (anchors, Anchor, i);
+      n_removed = next.old_pos - old_pos;
+      n_added   = next.new_pos - new_pos;
+
+      if (n_removed > 0 || n_added > 0)
+        {
+          g_autoptr (GPtrArray) removed = NULL;
+          guint len                     = 0;
+
+          removed = g_ptr_array_sized_new (n_removed);
+          for (guint j = 0; j < n_removed; j++)
+            g_ptr_array_add (removed, g_ptr_array_index (self->items, new_pos + j));
+          g_ptr_array_remove_range (self->items, new_pos, n_removed);
+          g_array_remove_range (self->scores, new_pos, n_removed);
+
+          g_array_insert_vals (
+              self->scores, new_pos,
+              &g_array_index (scores, BzSearchScore, new_pos),
+              n_added);
+          len = self->items->len;
+          g_ptr_array_set_size (self->items, len + n_added);
+          memmove (self->items->pdata + new_pos + n_added,
+                   self->items->pdata + new_pos,
+                   (len - new_pos) * sizeof (gpointer));
+          memset (self->items->pdata + new_pos, 0, n_added * sizeof (gpointer));
+
+          g_list_model_items_changed (G_LIST_MODEL (self), new_pos, n_removed, n_added);
+          release_items (self, removed);
+        }
+
+      if (i < anchors->len)
+        {
+          BzSearchScore       *score   = NULL;
+          const BzSearchScore *updated = NULL;
+          BzSearchResult      *result  = NULL;
+
+          score   = &g_array_index (self->scores, BzSearchScore, next.new_pos);
+          updated = &g_array_index (scores, BzSearchScore, next.new_pos);
+          result  = g_ptr_array_index (self->items, next.new_pos);
+
+          /* A surviving result only needs its score refreshed */
+          if (result != NULL && score->val != updated->val)
+            self->fill_func (result, updated, self->user_data);
+          *score = *updated;
+        }
+
+      old_pos = next.old_pos + 1;
+      new_pos = next.new_pos + 1;
+    }
+
+  g_array_unref (self->scores);
+  self->scores = g_array_ref (scores);
+}
+
+/* Pairs up the longest run of results which appear in
+ * the same order in both arrays. Every group occurs at
+ * most once, so this is the longest increasing run of
+ * old positions, taken in the new order
+ */
+static GArray *
+collect_anchors (GArray *old_scores,
+                 GArray *new_scores)
+{
+  g_autoptr (GHashTable) old_positions = NULL;
+  g_autofree guint *sources            = NULL;
+  g_autofree guint *tails              = NULL;
+  g_autofree guint *prev               = NULL;
+  guint n_tails                        = 0;
+  g_autoptr (GArray) anchors           = NULL;
+
+  /* Positions are offset by one so none are NULL */
+  old_positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (guint i = 0; i < old_scores->len; i++)
+    g_hash_table_replace (
+        old_positions,
+        GUINT_TO_POINTER (g_array_index (old_scores, BzSearchScore, i).idx),
+        GUINT_TO_POINTER (i + 1));
+
+  sources = g_new (guint, new_scores->len);
+  tails   = g_new (guint, new_scores->len);
+  prev    = g_new (guint, new_scores->len);
+
+  for (guint i = 0; i < new_scores->len; i++)
+    {
+      gpointer value = NULL;
+      guint    lo    = 0;
+      guint    hi    = n_tails;
+
+      value = g_hash_table_lookup (
+          old_positions,
+          GUINT_TO_POINTER (g_array_index (new_scores, BzSearchScore, i).idx));
+      if (value == NULL)
+        continue;
+      sources[i] = GPOINTER_TO_UINT (value) - 1;
+
+      /* `tails[k]` ends the best run of length k + 1 found so far */
+      while (lo < hi)
+        {
+          guint mid = lo + (hi - lo) / 2;
+
+          if (sources[tails[mid]] < sources[i])
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      prev[i]   = lo > 0 ? tails[lo - 1] : G_MAXUINT;
+      tails[lo] = i;
+      if (lo == n_tails)
+        n_tails++;
+    }
+
+  anchors = g_array_sized_new (FALSE, FALSE, sizeof (Anchor), n_tails);
+  g_array_set_size (anchors, n_tails);
+  for (guint k = n_tails, i = n_tails > 0 ? tails[n_tails - 1] : 0;
+       k > 0;
+       k--, i = prev[i])
+    {
+      Anchor *anchor = NULL;
+
+      anchor          = &g_array_index (anchors, Anchor, k - 1);
+      anchor->old_pos = sources[i];
+      anchor->new_pos = i;
+    }
+
+  return g_steal_pointer (&anchors);
+}
+
+static void
+release_items (BzSearchResultModel *self,
+               GPtrArray           *items)
+{
+  for (guint i = 0; i < items->len; i++)
+    {
+      BzSearchResult *result = NULL;
+
+      result = g_ptr_array_index (items, i);
+      if (result == NULL)
+        continue;
+
+      /* Results still referenced elsewhere, like by a
+       * list item being torn down, are left to them
+       */
+      if (g_hash_table_remove (self->idle, result) &&
+          self->pool->len < MAX_POOLED_RESULTS)
+        {
+          g_object_ref (result);
+          g_object_remove_toggle_ref (G_OBJECT (result), toggle_notify, self);
+
+          bz_search_result_set_group (result, NULL);
+          bz_search_result_set_id (result, NULL);
+          bz_search_result_set_title (result, NULL);
+          bz_search_result_set_description (result, NULL);
+          bz_search_result_set_title_markup (result, NULL);
+          g_ptr_array_add (self->pool, result);
+        }
+      else
+        g_object_remove_toggle_ref (G_OBJECT (result), toggle_notify, self);
+    }
+  g_ptr_array_set_size (items, 0);
+}
+
+/* Keeps track of which handed out results have been let
+ * go of again. Results are only ever passed around on the
+ * main thread, so this never races with `release_items`
+ */
+static void
+toggle_notify (gpointer data,
+               GObject *object,
+               gboolean is_last_ref)
+{
+  BzSearchResultModel *self = data;
+
+  if (is_last_ref)
+    g_hash_table_add (self->idle, object);
+  else
+    g_hash_table_remove (self->idle, object);
+}
+
+/* End of bz-search-result-model.c */
@@ -0,0 +1,54 @@
+/* bz-search-result-model.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include "bz-search-result.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  guint  idx;
+  double val;
+} BzSearchScore;
+
+typedef void (*BzSearchResultFillFunc) (BzSearchResult      *result,
+                                        const BzSearchScore *score,
+                                        gpointer             user_data);
+
+#define BZ_TYPE_SEARCH_RESULT_MODEL (bz_search_result_model_get_type ())
+G_DECLARE_FINAL_TYPE (BzSearchResultModel, bz_search_result_model, BZ, SEARCH_RESULT_MODEL, GObject)
+
+BzSearchResultModel *
+bz_search_result_model_new (void);
+
+void
+bz_search_result_model_set_scores (BzSearchResultModel   *self,
+                                   GArray                *scores,
+                                   BzSearchResultFillFunc fill_func,
+                                   gpointer               user_data,
+                                   GDestroyNotify         destroy_user_data);
+
+G_END_DECLS
+
+/* End of bz-search-result-model.h */
@@ -27,6 +27,7 @@
 #include "bz-group-tile-css-watcher.h"
 #include "bz-rich-app-tile.h"
 #include "bz-screenshot.h"
+#include "bz-search-result-model.h"
 #include "bz-search-result.h"
 #include "bz-search-widget.h"
 #include "bz-util.h"
@@ -40,10 +41,11 @@ struct _BzSearchWidget
   gboolean      remove;
   gboolean      search_in_progress;
 
-  GListStore        *search_model;
-  GtkSelectionModel *selection_model;
-  guint              search_update_timeout;
-  DexFuture         *search_query;
+  BzSearchResultModel *search_model;
+  GtkSelectionModel   *selection_model;
+  guint                search_update_timeout;
+  DexFuture           *search_query;
+  GCancellable        *search_cancellable;
 
   /* Template widgets */
   GtkText     *search_bar;
@@ -114,10 +116,14 @@ bz_search_widget_dispose (GObject *object)
 
   g_clear_handle_id (&self->search_update_timeout, g_source_remove);
   dex_clear (&self->search_query);
+  if (self->search_cancellable != NULL)
+    g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
 
   g_clear_object (&self->state);
   g_clear_object (&self->selected);
   g_clear_object (&self->selection_model);
+  g_clear_object (&self->search_model);
 
   G_OBJECT_CLASS (bz_search_widget_parent_class)->dispose (object);
 }
@@ -435,7 +441,7 @@ bz_search_widget_class_init (BzSearchWidgetClass *klass)
 static void
 bz_search_widget_init (BzSearchWidget *self)
 {
-  self->search_model = g_list_store_new (BZ_TYPE_SEARCH_RESULT);
+  self->search_model = bz_search_result_model_new ();
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
@@ -624,68 +630,19 @@ search_query_then (DexFuture *future,
                    GWeakRef  *wr)
 {
   g_autoptr (BzSearchWidget) self = NULL;
-  GPtrArray  *results             = NULL;
-  guint       old_length          = 0;
-  GSettings  *settings            = NULL;
+  guint       n_results           = 0;
   const char *page_name           = NULL;
 
   bz_weak_get_or_return_reject (self, wr);
 
-  results    = g_value_get_boxed (dex_future_get_value (future, NULL));
-  old_length = g_list_model_get_n_items (G_LIST_MODEL (self->search_model));
-  settings   = bz_state_info_get_settings (self->state);
-
-  if (settings != NULL &&
-      g_settings_get_boolean (settings, "search-only-foss"))
-    {
-      for (guint i = 0; i < results->len;)
-        {
-          BzSearchResult *result  = NULL;
-          BzEntryGroup   *group   = NULL;
-          gboolean        is_foss = FALSE;
-
-          result  = g_ptr_array_index (results, i);
-          group   = bz_search_result_get_group (result);
-          is_foss = bz_entry_group_get_is_floss (group);
-
-          if (is_foss)
-            i++;
-          else
-            g_ptr_array_remove_index (results, i);
-        }
-    }
-
-  if (settings != NULL &&
-      g_settings_get_boolean (settings, "search-only-flathub"))
-    {
-      for (guint i = 0; i < results->len;)
-        {
-          BzSearchResult *result     = NULL;
-          BzEntryGroup   *group      = NULL;
-          gboolean        is_flathub = FALSE;
-
-          result     = g_ptr_array_index (results, i);
-          group      = bz_search_result_get_group (result);
-          is_flathub = bz_entry_group_get_is_flathub (group);
-
-          if (is_flathub)
-            i++;
-          else
-            g_ptr_array_remove_index (results, i);
-        }
-    }
-
-  g_list_store_splice (
-      self->search_model,
-      0, old_length,
-      (gpointer *) results->pdata,
-      results->len);
+  /* The engine has already filled the model */
+  n_results = g_value_get_uint (dex_future_get_value (future, NULL));
   gtk_no_selection_set_model (
       GTK_NO_SELECTION (self->selection_model), G_LIST_MODEL (self->search_model));
 
   gtk_widget_set_visible (GTK_WIDGET (self->search_busy), FALSE);
 
-  if (results->len > 0)
+  if (n_results > 0)
     {
       page_name = "results";
       gtk_widget_activate_action (GTK_WIDGET (self->grid_view), "list.scroll-to-item", "u", 0);
@@ -705,8 +662,10 @@ search_query_then (DexFuture *future,
 static void
 update_filter (BzSearchWidget *self)
 {
-  BzSearchEngine *engine           = NULL;
-  const char     *search_text      = NULL;
+  BzSearchEngine     *engine       = NULL;
+  GSettings          *settings     = NULL;
+  const char         *search_text  = NULL;
+  BzSearchFilterFlags filter       = BZ_SEARCH_FILTER_NONE;
   g_autoptr (GStrvBuilder) builder = NULL;
   guint n_terms                    = 0;
   g_auto (GStrv) terms             = NULL;
@@ -716,6 +675,11 @@ update_filter (BzSearchWidget *self)
   g_clear_handle_id (&self->search_update_timeout, g_source_remove);
   dex_clear (&self->search_query);
 
+  /* Stop scoring for the previous text right away */
+  if (self->search_cancellable != NULL)
+    g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+
   gtk_widget_set_visible (GTK_WIDGET (self->search_busy), FALSE);
 
   if (self->state == NULL)
@@ -728,7 +692,7 @@ update_filter (BzSearchWidget *self)
 
   if (search_text == NULL || *search_text == '\0')
     {
-      g_list_store_remove_all (self->search_model);
+      bz_search_result_model_set_scores (self->search_model, NULL, NULL, NULL, NULL);
       gtk_no_selection_set_model (
           GTK_NO_SELECTION (self->selection_model), G_LIST_MODEL (self->search_model));
       gtk_stack_set_visible_child_name (self->search_stack, "empty");
@@ -751,7 +715,7 @@ update_filter (BzSearchWidget *self)
 
   if (n_terms == 0)
     {
-      g_list_store_remove_all (self->search_model);
+      bz_search_result_model_set_scores (self->search_model, NULL, NULL, NULL, NULL);
       gtk_no_selection_set_model (
           GTK_NO_SELECTION (self->selection_model), G_LIST_MODEL (self->search_model));
       gtk_stack_set_visible_child_name (self->search_stack, "empty");
@@ -760,11 +724,24 @@ update_filter (BzSearchWidget *self)
 
   terms = g_strv_builder_end (builder);
 
+  settings = bz_state_info_get_settings (self->state);
+  if (settings != NULL)
+    {
+      if (g_settings_get_boolean (settings, "search-only-foss"))
+        filter |= BZ_SEARCH_FILTER_FOSS;
+      if (g_settings_get_boolean (settings, "search-only-flathub"))
+        filter |= BZ_SEARCH_FILTER_FLATHUB;
+    }
+
   self->search_in_progress = TRUE;
+  self->search_cancellable = g_cancellable_new ();
 
-  future = bz_search_engine_query (
+  future = bz_search_engine_query_into (
       engine,
-      (const char *const *) terms);
+      (const char *const *) terms,
+      filter,
+      self->search_cancellable,
+      self->search_model);
   gtk_widget_set_visible (
       GTK_WIDGET (self->search_busy),
       dex_future_is_pending (future));
@@ -18,6 +18,8 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <gio/gio.h>
+
 #include "bz-serializable.h"
 
 G_DEFINE_INTERFACE (BzSerializable, bz_serializable, G_TYPE_OBJECT)
@@ -37,11 +39,36 @@ bz_serializable_real_deserialize (BzSerializable *self,
   return TRUE;
 }
 
+static const GVariantType *
+bz_serializable_real_get_compact_type (BzSerializable *self)
+{
+  return NULL;
+}
+
+static GVariant *
+bz_serializable_real_serialize_compact (BzSerializable *self)
+{
+  return NULL;
+}
+
+static gboolean
+bz_serializable_real_deserialize_compact (BzSerializable *self,
+                                          GVariant       *import,
+                                          GError        **error)
+{
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "%s has no compact form", G_OBJECT_TYPE_NAME (self));
+  return FALSE;
+}
+
 static void
 bz_serializable_default_init (BzSerializableInterface *iface)
 {
-  iface->serialize   = bz_serializable_real_serialize;
-  iface->deserialize = bz_serializable_real_deserialize;
+  iface->serialize           = bz_serializable_real_serialize;
+  iface->deserialize         = bz_serializable_real_deserialize;
+  iface->get_compact_type    = bz_serializable_real_get_compact_type;
+  iface->serialize_compact   = bz_serializable_real_serialize_compact;
+  iface->deserialize_compact = bz_serializable_real_deserialize_compact;
 }
 
 void
@@ -69,3 +96,35 @@ bz_serializable_deserialize (BzSerializable *self,
       import,
       error);
 }
+
+/* Returns NULL if the implementation has no compact form */
+const GVariantType *
+bz_serializable_get_compact_type (BzSerializable *self)
+{
+  g_return_val_if_fail (BZ_IS_SERIALIZABLE (self), NULL);
+
+  return BZ_SERIALIZABLE_GET_IFACE (self)->get_compact_type (self);
+}
+
+/* Returns NULL if the implementation has no compact form */
+GVariant *
+bz_serializable_serialize_compact (BzSerializable *self)
+{
+  g_return_val_if_fail (BZ_IS_SERIALIZABLE (self), NULL);
+
+  return BZ_SERIALIZABLE_GET_IFACE (self)->serialize_compact (self);
+}
+
+gboolean
+bz_serializable_deserialize_compact (BzSerializable *self,
+                                     GVariant       *import,
+                                     GError        **error)
+{
+  g_return_val_if_fail (BZ_IS_SERIALIZABLE (self), FALSE);
+  g_return_val_if_fail (import != NULL, FALSE);
+
+  return BZ_SERIALIZABLE_GET_IFACE (self)->deserialize_compact (
+      self,
+      import,
+      error);
+}
@@ -37,6 +37,17 @@ struct _BzSerializableInterface
   gboolean (*deserialize) (BzSerializable *self,
                            GVariant       *import,
                            GError        **error);
+
+  /* Optional fixed layout form, which carries no keys
+   * and is of the type returned by get_compact_type
+   */
+  const GVariantType *(*get_compact_type) (BzSerializable *self);
+
+  GVariant *(*serialize_compact) (BzSerializable *self);
+
+  gboolean (*deserialize_compact) (BzSerializable *self,
+                                   GVariant       *import,
+                                   GError        **error);
 };
 
 void
@@ -48,4 +59,15 @@ bz_serializable_deserialize (BzSerializable *self,
                              GVariant       *import,
                              GError        **error);
 
+const GVariantType *
+bz_serializable_get_compact_type (BzSerializable *self);
+
+GVariant *
+bz_serializable_serialize_compact (BzSerializable *self);
+
+gboolean
+bz_serializable_deserialize_compact (BzSerializable *self,
+                                     GVariant       *import,
+                                     GError        **error);
+
 G_END_DECLS